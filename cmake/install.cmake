@@ -41,6 +41,15 @@ install(DIRECTORY include/OpenImageDenoise
   PATTERN "*.in" EXCLUDE
 )
 
+## ----------------------------------------------------------------------------
+## Install Python module
+## ----------------------------------------------------------------------------
+
+install(FILES python/oidn.py
+  DESTINATION ${CMAKE_INSTALL_LIBDIR}/python
+  COMPONENT lib
+)
+
 ## ----------------------------------------------------------------------------
 ## Install documentation
 ## ----------------------------------------------------------------------------
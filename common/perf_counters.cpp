@@ -0,0 +1,166 @@
+// ======================================================================== //
+// Copyright 2009-2019 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "perf_counters.h"
+
+#if defined(__linux__)
+  #include <linux/perf_event.h>
+  #include <sys/ioctl.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+  #include <cstring>
+#endif
+
+namespace oidn {
+
+  // --------------------------------------------------------------------------
+  // PerfCounters
+  // --------------------------------------------------------------------------
+
+#if defined(__linux__)
+
+  namespace
+  {
+    int openCounter(uint64_t config, int groupFd)
+    {
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = config;
+      attr.read_format = PERF_FORMAT_GROUP;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+
+      // Count the calling thread on any CPU
+      return int(syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0));
+    }
+  }
+
+  PerfCounters::PerfCounters() {}
+
+  PerfCounters::~PerfCounters()
+  {
+    for (const auto& item : threads)
+    {
+      const ThreadCounters& counters = item.second;
+      if (counters.cacheMissesFd >= 0)
+        close(counters.cacheMissesFd);
+      if (counters.instructionsFd >= 0)
+        close(counters.instructionsFd);
+      if (counters.groupFd >= 0)
+        close(counters.groupFd);
+    }
+  }
+
+  void PerfCounters::attachCurrentThread()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (!available)
+      return;
+
+    const std::thread::id threadId = std::this_thread::get_id();
+    if (threads.find(threadId) != threads.end())
+      return;
+
+    ThreadCounters counters;
+    counters.groupFd = openCounter(PERF_COUNT_HW_CPU_CYCLES, -1);
+    if (counters.groupFd < 0)
+    {
+      // Performance counters are not supported or not permitted
+      available = false;
+      return;
+    }
+
+    if (hasInstructions)
+    {
+      counters.instructionsFd = openCounter(PERF_COUNT_HW_INSTRUCTIONS, counters.groupFd);
+      if (counters.instructionsFd < 0)
+        hasInstructions = false;
+    }
+
+    if (hasCacheMisses)
+    {
+      counters.cacheMissesFd = openCounter(PERF_COUNT_HW_CACHE_MISSES, counters.groupFd);
+      if (counters.cacheMissesFd < 0)
+        hasCacheMisses = false;
+    }
+
+    threads[threadId] = counters;
+  }
+
+  PerfCounterValues PerfCounters::read()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    PerfCounterValues sum;
+    if (!available)
+      return sum;
+
+    for (const auto& item : threads)
+    {
+      const ThreadCounters& counters = item.second;
+
+      // The values are returned in the order the counters were added to the group
+      uint64_t data[4] = {0}; // number of values, cycles, instructions, cache misses
+      if (::read(counters.groupFd, data, sizeof(data)) <= 0)
+        continue;
+
+      PerfCounterValues values;
+      int i = 1;
+      values.cycles = data[i++];
+      if (counters.instructionsFd >= 0)
+        values.instructions = data[i++];
+      if (counters.cacheMissesFd >= 0)
+        values.cacheMisses = data[i++];
+      sum += values;
+    }
+
+    return sum;
+  }
+
+#else
+
+  PerfCounters::PerfCounters() : available(false) {}
+  PerfCounters::~PerfCounters() {}
+  void PerfCounters::attachCurrentThread() {}
+  PerfCounterValues PerfCounters::read() { return PerfCounterValues(); }
+
+#endif
+
+  // --------------------------------------------------------------------------
+  // PerfCounterObserver
+  // --------------------------------------------------------------------------
+
+  PerfCounterObserver::PerfCounterObserver(const std::shared_ptr<PerfCounters>& counters, tbb::task_arena& arena)
+    : tbb::task_scheduler_observer(arena),
+      counters(counters)
+  {
+    observe(true);
+  }
+
+  PerfCounterObserver::~PerfCounterObserver()
+  {
+    observe(false);
+  }
+
+  void PerfCounterObserver::on_scheduler_entry(bool isWorker)
+  {
+    counters->attachCurrentThread();
+  }
+
+} // namespace oidn
@@ -0,0 +1,110 @@
+// ======================================================================== //
+// Copyright 2009-2019 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "tasking.h"
+#include <map>
+#include <thread>
+
+namespace oidn {
+
+  // --------------------------------------------------------------------------
+  // PerfCounterValues
+  // --------------------------------------------------------------------------
+
+  struct PerfCounterValues
+  {
+    uint64_t cycles       = 0;
+    uint64_t instructions = 0;
+    uint64_t cacheMisses  = 0; // last level cache misses
+
+    PerfCounterValues& operator +=(const PerfCounterValues& other)
+    {
+      cycles       += other.cycles;
+      instructions += other.instructions;
+      cacheMisses  += other.cacheMisses;
+      return *this;
+    }
+
+    PerfCounterValues operator -(const PerfCounterValues& other) const
+    {
+      PerfCounterValues result;
+      result.cycles       = cycles       - other.cycles;
+      result.instructions = instructions - other.instructions;
+      result.cacheMisses  = cacheMisses  - other.cacheMisses;
+      return result;
+    }
+  };
+
+  // --------------------------------------------------------------------------
+  // PerfCounters
+  // --------------------------------------------------------------------------
+
+  // Hardware performance counters aggregated over a set of threads
+  // Currently supported only on Linux (perf_event_open). If the counters are
+  // not available (e.g. not permitted in a container), isAvailable returns
+  // false and all values are zero.
+  class PerfCounters
+  {
+  private:
+    struct ThreadCounters
+    {
+      int groupFd = -1;          // leader (cycles)
+      int instructionsFd = -1;
+      int cacheMissesFd = -1;
+    };
+
+    std::map<std::thread::id, ThreadCounters> threads;
+    std::mutex mutex;
+
+    bool available = true;
+    bool hasInstructions = true;
+    bool hasCacheMisses = true;
+
+  public:
+    PerfCounters();
+    ~PerfCounters();
+
+    // Starts counting the events of the calling thread (if not already counting)
+    void attachCurrentThread();
+
+    // Returns the sum of the counter values of all attached threads
+    PerfCounterValues read();
+
+    bool isAvailable() const { return available; }
+    bool hasInstructionCounter() const { return available && hasInstructions; }
+    bool hasCacheMissCounter() const { return available && hasCacheMisses; }
+  };
+
+  // --------------------------------------------------------------------------
+  // PerfCounterObserver
+  // --------------------------------------------------------------------------
+
+  // Attaches the threads entering an arena to performance counters
+  class PerfCounterObserver : public tbb::task_scheduler_observer
+  {
+  private:
+    std::shared_ptr<PerfCounters> counters;
+
+  public:
+    PerfCounterObserver(const std::shared_ptr<PerfCounters>& counters, tbb::task_arena& arena);
+    ~PerfCounterObserver();
+
+    void on_scheduler_entry(bool isWorker) override;
+  };
+
+} // namespace oidn
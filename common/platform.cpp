@@ -16,6 +16,12 @@
 
 #include "platform.h"
 
+#if defined(_WIN32)
+  #include <intrin.h>
+#else
+  #include <cpuid.h>
+#endif
+
 namespace oidn {
 
   void* alignedMalloc(size_t size, size_t alignment)
@@ -38,4 +44,33 @@ namespace oidn {
       _mm_free(ptr);
   }
 
+  std::string getCPUName()
+  {
+    int regs[12] = {0};
+
+  #if defined(_WIN32)
+    __cpuid(regs, 0x80000000);
+    if ((unsigned int)regs[0] < 0x80000004)
+      return "Unknown";
+
+    __cpuid(&regs[0], 0x80000002);
+    __cpuid(&regs[4], 0x80000003);
+    __cpuid(&regs[8], 0x80000004);
+  #else
+    unsigned int* r = (unsigned int*)regs;
+    if (__get_cpuid_max(0x80000000, nullptr) < 0x80000004)
+      return "Unknown";
+
+    __get_cpuid(0x80000002, &r[0], &r[1], &r[2],  &r[3]);
+    __get_cpuid(0x80000003, &r[4], &r[5], &r[6],  &r[7]);
+    __get_cpuid(0x80000004, &r[8], &r[9], &r[10], &r[11]);
+  #endif
+
+    std::string name((const char*)regs, sizeof(regs));
+    name = name.substr(0, name.find('\0'));
+    const size_t first = name.find_first_not_of(' ');
+    const size_t last  = name.find_last_not_of(' ');
+    return (first != std::string::npos) ? name.substr(first, last - first + 1) : "Unknown";
+  }
+
 } // namespace oidn
@@ -27,6 +27,7 @@
 #include <xmmintrin.h>
 #include <cstdint>
 #include <climits>
+#include <limits>
 #include <atomic>
 #include <algorithm>
 #include <memory>
@@ -87,6 +88,9 @@ namespace oidn {
   void* alignedMalloc(size_t size, size_t alignment);
   void alignedFree(void* ptr);
 
+  // Returns the brand string of the CPU
+  std::string getCPUName();
+
 #if defined(__APPLE__)
   template<typename T>
   bool getSysctl(const char* name, T& value)
@@ -28,9 +28,10 @@ namespace oidn {
     observe(true);
   }
 
-  PinningObserver::PinningObserver(const std::shared_ptr<ThreadAffinity>& affinity, tbb::task_arena& arena)
+  PinningObserver::PinningObserver(const std::shared_ptr<ThreadAffinity>& affinity, tbb::task_arena& arena, int threadIndexOffset)
     : tbb::task_scheduler_observer(arena),
-      affinity(affinity)
+      affinity(affinity),
+      threadIndexOffset(threadIndexOffset)
   {
     observe(true);
   }
@@ -42,13 +43,13 @@ namespace oidn {
 
   void PinningObserver::on_scheduler_entry(bool isWorker)
   {
-    const int threadIndex = tbb::this_task_arena::current_thread_index();
+    const int threadIndex = tbb::this_task_arena::current_thread_index() + threadIndexOffset;
     affinity->set(threadIndex);
   }
 
   void PinningObserver::on_scheduler_exit(bool isWorker)
   {
-    const int threadIndex = tbb::this_task_arena::current_thread_index();
+    const int threadIndex = tbb::this_task_arena::current_thread_index() + threadIndexOffset;
     affinity->restore(threadIndex);
   }
 
@@ -43,10 +43,11 @@ namespace oidn {
   {
   private:
     std::shared_ptr<ThreadAffinity> affinity;
+    int threadIndexOffset = 0; // added to the thread indices in the arena (e.g. to pin several arenas to disjoint cores)
 
   public:
     explicit PinningObserver(const std::shared_ptr<ThreadAffinity>& affinity);
-    PinningObserver(const std::shared_ptr<ThreadAffinity>& affinity, tbb::task_arena& arena);
+    PinningObserver(const std::shared_ptr<ThreadAffinity>& affinity, tbb::task_arena& arena, int threadIndexOffset = 0);
     ~PinningObserver();
 
     void on_scheduler_entry(bool isWorker) override;
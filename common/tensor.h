@@ -22,16 +22,13 @@
 
 namespace oidn {
 
-  template<typename T>
-  using shared_vector = std::shared_ptr<std::vector<T>>;
-
   // Generic tensor
   struct Tensor
   {
     float* data;
     std::vector<int> dims;
     std::string format;
-    shared_vector<char> buffer; // optional, only for reference counting
+    std::shared_ptr<char> buffer; // optional, only for reference counting
 
     __forceinline Tensor() : data(nullptr) {}
 
@@ -39,8 +36,9 @@ namespace oidn {
       : dims(dims),
         format(format)
     {
-      buffer = std::make_shared<std::vector<char>>(size() * sizeof(float));
-      data = (float*)buffer->data();
+      // The data is not initialized, as it is usually overwritten anyway
+      buffer = std::shared_ptr<char>((char*)alignedMalloc(size() * sizeof(float), 64), alignedFree);
+      data = (float*)buffer.get();
     }
 
     __forceinline operator bool() const { return data != nullptr; }
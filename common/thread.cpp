@@ -28,6 +28,81 @@
 
 namespace oidn {
 
+  // --------------------------------------------------------------------------
+  // WorkerThread
+  // --------------------------------------------------------------------------
+
+  WorkerThread::~WorkerThread()
+  {
+    if (thread.joinable())
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        exit = true;
+      }
+      cond.notify_all();
+      thread.join();
+    }
+  }
+
+  void WorkerThread::run(const std::function<void()>& f)
+  {
+    if (!thread.joinable())
+      thread = std::thread([this]() { loop(); });
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      assert(!busy);
+      task = f;
+      error = nullptr;
+      busy = true;
+    }
+    cond.notify_all();
+  }
+
+  void WorkerThread::wait()
+  {
+    std::exception_ptr taskError;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cond.wait(lock, [&]() { return !busy; });
+      std::swap(taskError, error);
+    }
+
+    if (taskError)
+      std::rethrow_exception(taskError);
+  }
+
+  void WorkerThread::loop()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true)
+    {
+      cond.wait(lock, [&]() { return busy || exit; });
+      if (!busy)
+        return;
+
+      lock.unlock();
+      std::exception_ptr taskError;
+      try
+      {
+        task();
+      }
+      catch (...)
+      {
+        taskError = std::current_exception();
+      }
+      lock.lock();
+
+      task = nullptr;
+      error = taskError;
+      busy = false;
+      cond.notify_all();
+    }
+  }
+
 #if defined(_WIN32)
 
   // --------------------------------------------------------------------------
@@ -28,6 +28,10 @@
 
 #include <vector>
 #include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <exception>
 
 namespace oidn {
 
@@ -104,6 +108,41 @@ namespace oidn {
     }
   };
 
+  // --------------------------------------------------------------------------
+  // WorkerThread
+  // --------------------------------------------------------------------------
+
+  // Thread which executes tasks one at a time, and is kept alive between them
+  // (started on first use)
+  class WorkerThread
+  {
+  private:
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::function<void()> task;
+    std::exception_ptr error; // thrown by the last task
+    bool busy = false;
+    bool exit = false;
+
+  public:
+    WorkerThread() = default;
+    ~WorkerThread();
+
+    WorkerThread(const WorkerThread&) = delete;
+    WorkerThread& operator =(const WorkerThread&) = delete;
+
+    // Starts executing a task, which must not be called before the previous
+    // task has been waited for
+    void run(const std::function<void()>& f);
+
+    // Waits for the current task to finish and rethrows its exception (if any)
+    void wait();
+
+  private:
+    void loop();
+  };
+
 #if defined(_WIN32)
 
   // --------------------------------------------------------------------------
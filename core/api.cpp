@@ -96,6 +96,32 @@ namespace oidn {
         OIDN_CATCH(obj)
       }
     }
+
+    // Keeps a filter alive while the device mutex is unlocked (e.g. during
+    // execution), as another thread may release it meanwhile
+    // Must be declared after locking the device mutex, because the filter is
+    // destroyed by the guard if it was the last reference, and filters must be
+    // destroyed with the device mutex locked.
+    class FilterGuard
+    {
+    private:
+      Filter* filter;
+
+    public:
+      explicit FilterGuard(Filter* filter) : filter(filter)
+      {
+        filter->incRef();
+      }
+
+      ~FilterGuard()
+      {
+        if (filter->decRefKeep() == 0)
+          filter->destroy();
+      }
+
+      FilterGuard(const FilterGuard&) = delete;
+      FilterGuard& operator =(const FilterGuard&) = delete;
+    };
   }
 
   OIDN_API OIDNDevice oidnNewDevice(OIDNDeviceType type)
@@ -194,6 +220,26 @@ namespace oidn {
     OIDN_CATCH(device)
   }
 
+  OIDN_API void oidnAutotuneDevice(OIDNDevice hDevice)
+  {
+    Device* device = (Device*)hDevice;
+    OIDN_TRY
+      checkHandle(hDevice);
+      OIDN_LOCK(device);
+      device->autotuneThreads();
+    OIDN_CATCH(device)
+  }
+
+  OIDN_API void oidnTrimDevice(OIDNDevice hDevice)
+  {
+    Device* device = (Device*)hDevice;
+    OIDN_TRY
+      checkHandle(hDevice);
+      OIDN_LOCK(device);
+      device->trim();
+    OIDN_CATCH(device)
+  }
+
   OIDN_API OIDNBuffer oidnNewBuffer(OIDNDevice hDevice, size_t byteSize)
   {
     Device* device = (Device*)hDevice;
@@ -218,6 +264,25 @@ namespace oidn {
     return nullptr;
   }
 
+  OIDN_API OIDNBuffer oidnNewImageBuffer(OIDNDevice hDevice, OIDNFormat format,
+                                         size_t width, size_t height,
+                                         size_t* bytePixelStride, size_t* byteRowStride)
+  {
+    Device* device = (Device*)hDevice;
+    OIDN_TRY
+      checkHandle(hDevice);
+      OIDN_LOCK(device);
+      size_t pixelStride, rowStride;
+      Ref<Buffer> buffer = device->newImageBuffer((Format)format, (int)width, (int)height, pixelStride, rowStride);
+      if (bytePixelStride)
+        *bytePixelStride = pixelStride;
+      if (byteRowStride)
+        *byteRowStride = rowStride;
+      return (OIDNBuffer)buffer.detach();
+    OIDN_CATCH(device)
+    return nullptr;
+  }
+
   OIDN_API void oidnRetainBuffer(OIDNBuffer hBuffer)
   {
     Buffer* buffer = (Buffer*)hBuffer;
@@ -329,6 +394,16 @@ namespace oidn {
     OIDN_CATCH(filter)
   }
 
+  OIDN_API void oidnSetFilter1f(OIDNFilter hFilter, const char* name, float value)
+  {
+    Filter* filter = (Filter*)hFilter;
+    OIDN_TRY
+      checkHandle(hFilter);
+      OIDN_LOCK(filter);
+      filter->set1f(name, value);
+    OIDN_CATCH(filter)
+  }
+
   OIDN_API bool oidnGetFilter1b(OIDNFilter hFilter, const char* name)
   {
     Filter* filter = (Filter*)hFilter;
@@ -351,24 +426,118 @@ namespace oidn {
     return 0;
   }
 
+  OIDN_API float oidnGetFilter1f(OIDNFilter hFilter, const char* name)
+  {
+    Filter* filter = (Filter*)hFilter;
+    OIDN_TRY
+      checkHandle(hFilter);
+      OIDN_LOCK(filter);
+      return filter->get1f(name);
+    OIDN_CATCH(filter)
+    return 0;
+  }
+
+  OIDN_API void oidnSetFilterProgressMonitorFunction(OIDNFilter hFilter, OIDNProgressMonitorFunction func, void* userPtr)
+  {
+    Filter* filter = (Filter*)hFilter;
+    OIDN_TRY
+      checkHandle(hFilter);
+      OIDN_LOCK(filter);
+      filter->setProgressMonitorFunction((ProgressMonitorFunction)func, userPtr);
+    OIDN_CATCH(filter)
+  }
+
   OIDN_API void oidnCommitFilter(OIDNFilter hFilter)
   {
     Filter* filter = (Filter*)hFilter;
+    Ref<Device> device; // for reporting errors, as the filter may have been released meanwhile
     OIDN_TRY
       checkHandle(hFilter);
+      device = filter->getDevice();
       OIDN_LOCK(filter);
+      FilterGuard filterGuard(filter);
       filter->commit();
+    OIDN_CATCH(device)
+  }
+
+  OIDN_API size_t oidnEstimateFilterCost(OIDNFilter hFilter,
+                                         size_t width, size_t height,
+                                         bool albedo, bool normal, int numThreads,
+                                         OIDNLayerCost* layers, size_t maxLayers,
+                                         double* time, size_t* memoryByteSize)
+  {
+    Filter* filter = (Filter*)hFilter;
+    OIDN_TRY
+      checkHandle(hFilter);
+      OIDN_LOCK(filter);
+      if (width > Image::maxSize || height > Image::maxSize)
+        throw Exception(Error::InvalidArgument, "image size too large");
+      if (numThreads < 0)
+        throw Exception(Error::InvalidArgument, "invalid number of threads");
+      if (layers == nullptr && maxLayers > 0)
+        throw Exception(Error::InvalidArgument, "layer array pointer null");
+
+      size_t totalMemoryByteSize = 0;
+      const std::vector<LayerCost> costs = filter->estimateCost((int)width, (int)height, albedo, normal, numThreads, totalMemoryByteSize);
+
+      double totalTime = 0;
+      for (size_t i = 0; i < costs.size(); ++i)
+      {
+        totalTime += costs[i].time;
+        if (i < maxLayers)
+          layers[i] = costs[i];
+      }
+
+      if (time)
+        *time = totalTime;
+      if (memoryByteSize)
+        *memoryByteSize = totalMemoryByteSize;
+      return costs.size();
     OIDN_CATCH(filter)
+    return 0;
+  }
+
+  OIDN_API void* oidnGetFilterTensor(OIDNFilter hFilter, const char* name, OIDNTensorDesc* desc)
+  {
+    Filter* filter = (Filter*)hFilter;
+    OIDN_TRY
+      checkHandle(hFilter);
+      OIDN_LOCK(filter);
+      TensorDesc tensorDesc;
+      void* ptr = filter->getTensor(name, tensorDesc);
+      if (desc)
+        *desc = tensorDesc;
+      return ptr;
+    OIDN_CATCH(filter)
+    return nullptr;
   }
 
   OIDN_API void oidnExecuteFilter(OIDNFilter hFilter)
   {
     Filter* filter = (Filter*)hFilter;
+    Ref<Device> device; // for reporting errors, as the filter may have been released meanwhile
     OIDN_TRY
       checkHandle(hFilter);
+      device = filter->getDevice();
       OIDN_LOCK(filter);
+      FilterGuard filterGuard(filter);
       filter->execute();
-    OIDN_CATCH(filter)
+    OIDN_CATCH(device)
+  }
+
+  OIDN_API void oidnExecuteFilterSequence(OIDNFilter hFilter, const OIDNFrame* frames, size_t numFrames)
+  {
+    Filter* filter = (Filter*)hFilter;
+    Ref<Device> device; // for reporting errors, as the filter may have been released meanwhile
+    OIDN_TRY
+      checkHandle(hFilter);
+      device = filter->getDevice();
+      if (frames == nullptr && numFrames > 0)
+        throw Exception(Error::InvalidArgument, "frames pointer null");
+      OIDN_LOCK(filter);
+      FilterGuard filterGuard(filter);
+      filter->executeSequence(frames, numFrames);
+    OIDN_CATCH(device)
   }
 
 } // namespace oidn
@@ -15,6 +15,7 @@
 // ======================================================================== //
 
 #include "autoencoder.h"
+#include "common/timer.h"
 
 namespace oidn {
 
@@ -23,12 +24,17 @@ namespace oidn {
   // --------------------------------------------------------------------------
 
   AutoencoderFilter::AutoencoderFilter(const Ref<Device>& device)
-    : Filter(device)
+    : Filter(device),
+      numNonFinitePixels(0),
+      numNegativePixels(0)
   {
+    resetExecutionTimes();
   }
 
   void AutoencoderFilter::setImage(const std::string& name, const Image& data)
   {
+    checkNotExecuting();
+
     if (name == "color")
       color = data;
     else if (name == "albedo")
@@ -37,16 +43,55 @@ namespace oidn {
       normal = data;
     else if (name == "output")
       output = data;
+    else if (name == "motion")
+      motion = data;
 
     dirty = true;
   }
 
   void AutoencoderFilter::set1i(const std::string& name, int value)
   {
+    checkNotExecuting();
+
+    // Parameters which do not require committing
+    if (name == "priority")
+    {
+      priority = value;
+      return;
+    }
+    else if (name == "autoexposureStride")
+    {
+      if (value < 1)
+        throw Exception(Error::InvalidArgument, "invalid autoexposure stride");
+      autoexposureStride = value;
+      return;
+    }
+    else if (name == "resetHistory")
+    {
+      resetHistory = value;
+      return;
+    }
+
     if (name == "hdr")
       hdr = value;
     else if (name == "srgb")
       srgb = value;
+    else if (name == "maxBatchSize")
+    {
+      if (value < 1)
+        throw Exception(Error::InvalidArgument, "invalid maximum batch size");
+      maxBatchSize = value;
+    }
+    else if (name == "directInput")
+      directInput = value;
+    else if (name == "directOutput")
+      directOutput = value;
+    else if (name == "convAlgo")
+    {
+      if (value < int(ConvAlgo::Auto) || value > int(ConvAlgo::Winograd))
+        throw Exception(Error::InvalidArgument, "invalid convolution algorithm");
+      convAlgo = ConvAlgo(value);
+    }
 
     dirty = true;
   }
@@ -57,23 +102,137 @@ namespace oidn {
       return hdr;
     else if (name == "srgb")
       return srgb;
+    else if (name == "priority")
+      return priority;
+    else if (name == "autoexposureStride")
+      return autoexposureStride;
+    else if (name == "maxBatchSize")
+      return maxBatchSize;
+    else if (name == "directInput")
+      return directInput;
+    else if (name == "directOutput")
+      return directOutput;
+    else if (name == "convAlgo")
+      return int(convAlgo);
+    else if (name == "previewScale")
+      return previewScale;
+    else if (name == "resetHistory")
+      return resetHistory;
+    else if (name == "numNonFinitePixels")
+      return int(min(numNonFinitePixels.load(), int64_t(INT_MAX))); // saturated
+    else if (name == "numNegativePixels")
+      return int(min(numNegativePixels.load(), int64_t(INT_MAX)));
     else
       throw Exception(Error::InvalidArgument, "invalid parameter");
   }
 
+  void AutoencoderFilter::set1f(const std::string& name, float value)
+  {
+    checkNotExecuting();
+
+    // None of the float parameters require committing
+    if (name == "hdrScale")
+    {
+      if (!std::isnan(value) && !(value > 0.f && isfinite(value)))
+        throw Exception(Error::InvalidArgument, "invalid HDR scale");
+      hdrScale = value;
+    }
+    else if (name == "autoexposureSmoothing")
+    {
+      if (!(value >= 0.f && value < 1.f))
+        throw Exception(Error::InvalidArgument, "invalid autoexposure smoothing");
+      autoexposureSmoothing = value;
+      prevExposure = std::numeric_limits<float>::quiet_NaN();
+    }
+    else if (name == "timeBudget")
+    {
+      if (!(value >= 0.f && isfinite(value)))
+        throw Exception(Error::InvalidArgument, "invalid time budget");
+      timeBudget = value;
+    }
+    else if (name == "temporalBlend")
+    {
+      if (!(value >= 0.f && value < 1.f))
+        throw Exception(Error::InvalidArgument, "invalid temporal blend");
+      temporalBlend = value;
+      if (temporal)
+        temporal->setBlend(value);
+    }
+    else if (name == "idleTimeout")
+      setIdleTimeout(value);
+  }
+
+  float AutoencoderFilter::get1f(const std::string& name)
+  {
+    if (name == "hdrScale")
+      return hdrScale;
+    else if (name == "autoexposureSmoothing")
+      return autoexposureSmoothing;
+    else if (name == "timeBudget")
+      return timeBudget;
+    else if (name == "temporalBlend")
+      return temporalBlend;
+    else if (name == "idleTimeout")
+      return idleTimeout;
+    else
+      throw Exception(Error::InvalidArgument, "invalid parameter");
+  }
+
+  std::vector<LayerCost> AutoencoderFilter::estimateCost(int width, int height, bool hasAlbedo, bool hasNormal,
+                                                         int numThreads, size_t& memoryByteSize)
+  {
+    int inputC;
+    const auto weightMap = parseTensors(getWeights(true, hasAlbedo, hasNormal, inputC));
+
+    std::vector<LayerCost> costs;
+    if (mayiuse(avx512_common))
+      costs = getLayerCosts<16>(weightMap, inputC, width, height, memoryByteSize);
+    else
+      costs = getLayerCosts<8>(weightMap, inputC, width, height, memoryByteSize);
+
+    // Measure the throughput of the device on first use
+    const Throughput* throughput = nullptr;
+    executeExclusive([&]() { throughput = &device->getThroughput(); });
+
+    if (numThreads == 0)
+      numThreads = device->getNumThreads();
+    for (auto& cost : costs)
+      cost.time = estimateTime(cost, *throughput, numThreads);
+
+    return costs;
+  }
+
   void AutoencoderFilter::commit()
   {
+    // The buffers and networks released below may be in use by an execution
+    // on another thread (the device mutex is unlocked while executing)
+    checkNotExecuting();
+
     if (!dirty)
       return;
 
-    device->executeTask([&]()
-    {
-      if (mayiuse(avx512_common))
-        net = buildNet<16>();
-      else
-        net = buildNet<8>();
-    });
+    // Release the memory of the previous configuration, and reserve the
+    // estimated memory of the new one if the device has a memory budget
+    trimMemory();
+    if (net)
+      net->releaseScratch(); // not trimmed with direct tensor I/O
+    for (auto& preview : previews)
+      preview = Preview();
+    const size_t memoryByteSize = device->getMemoryBudget() > 0 ? estimateMemoryByteSize() : 0;
 
+    executeExclusive([&]()
+    {
+      device->executeTask([&]()
+      {
+        if (mayiuse(avx512_common))
+          net = buildNet<16>();
+        else
+          net = buildNet<8>();
+      });
+    }, memoryByteSize);
+
+    prevExposure = std::numeric_limits<float>::quiet_NaN();
+    resetExecutionTimes();
     dirty = false;
   }
 
@@ -82,110 +241,624 @@ namespace oidn {
     if (dirty)
       throw Exception(Error::InvalidOperation, "changes to the filter are not committed");
 
-    device->executeTask([&]()
+    // The profiler is accessed only inside the exclusive execution, because
+    // another execution of the filter may be running on a different thread
+    executeExclusive([&]()
     {
-      if (hdr)
+      if (profiler)
+        profiler->reset();
+
+      device->executeTask([&]()
       {
-        const float exposure = autoexposure(color);
-        //printf("exposure = %f\n", exposure);
-        std::static_pointer_cast<HDRTransferFunc>(transferFunc)->setExposure(exposure);
-      }
+        numNonFinitePixels = 0;
+        numNegativePixels = 0;
+
+        // Without the input reorder, the exposure cannot be computed
+        // automatically, but the output reorder may still need it
+        if (directInput && hdr)
+          static_cast<HDRTransferFunc&>(*transferFunc).setExposure(std::isnan(hdrScale) ? 1.f : hdrScale);
+
+        // Select the resolution which is predicted to meet the time budget
+        const int scaleIndex = selectPreviewScale();
+        if (scaleIndex == 0)
+        {
+          net->allocScratch(); // not timed
+          Timer timer;
+          Progress progress(device.get(), progressFunc, progressUserPtr, net->getWorkAmount());
+          net->execute(progress);
+          progress.finish();
+          updateExecutionTime(scaleIndex, timer.query() * 1000.);
+        }
+        else
+        {
+          const Preview& preview = getPreview(scaleIndex);
+          const int scale = 1 << scaleIndex;
+
+          preview.net->allocScratch(); // not timed
+          Timer timer;
+          Progress progress(device.get(), progressFunc, progressUserPtr, preview.net->getWorkAmount());
+          downsampleImage(color, preview.color, scale);
+          if (albedo)
+            downsampleImage(albedo, preview.albedo, scale);
+          if (normal)
+            downsampleImage(normal, preview.normal, scale);
+          preview.net->execute(progress);
+          upsampleImage(preview.output, output);
+          progress.finish();
+          updateExecutionTime(scaleIndex, timer.query() * 1000.);
+        }
+
+        previewScale = 1 << scaleIndex;
+
+        if (temporal)
+        {
+          if (resetHistory)
+            temporal->reset();
+          temporal->execute();
+        }
+        resetHistory = false;
+      });
+
+      if (profiler)
+        profiler->print(std::cout);
+    }, getMemoryByteSize(false)); // the buffers of the lower resolutions are accounted after allocation
+  }
+
+  void AutoencoderFilter::executeSequence(const Frame* frames, size_t numFrames)
+  {
+    if (dirty)
+      throw Exception(Error::InvalidOperation, "changes to the filter are not committed");
+    if (!sequence)
+      throw Exception(Error::InvalidOperation, "sequences are not supported with direct tensor I/O");
 
-      net->execute();
-    });
+    executeExclusive([&]()
+    {
+      if (profiler)
+        profiler->reset();
+
+      numNonFinitePixels = 0;
+      numNegativePixels = 0;
+      if (temporal && resetHistory)
+        temporal->reset();
+      resetHistory = false;
+      sequence->execute(frames, numFrames, progressFunc, progressUserPtr);
+
+      if (profiler)
+        profiler->print(std::cout);
+    }, getMemoryByteSize(false)); // the buffers of the pipeline are accounted after allocation
   }
 
-  template<int K>
-  std::shared_ptr<Node> AutoencoderFilter::buildNet()
+  void* AutoencoderFilter::getTensor(const std::string& name, TensorDesc& desc)
   {
-    constexpr int spatialPad = 32; // the image must be padded spatially
+    checkNotExecuting();
+    if (dirty)
+      throw Exception(Error::InvalidOperation, "changes to the filter are not committed");
 
-    const int width = color.width;
-    const int height = color.height;
+    std::shared_ptr<memory> tensor;
+    if (name == "input" && directInput)
+    {
+      tensor = netInput;
+      desc.numChannels = netInputC;
+    }
+    else if (name == "output" && directOutput)
+    {
+      tensor = netOutput;
+      desc.numChannels = 3;
+    }
+    else
+      throw Exception(Error::InvalidArgument, "invalid tensor or direct tensor I/O not enabled");
+
+    // Allocate the tensors if they were released when committing, and restart
+    // the idle time
+    // The filter cannot be modified while waiting for memory (the device
+    // mutex may be unlocked).
+    executing = true;
+    try
+    {
+      device->reserveMemory(this, getMemoryByteSize(false));
+    }
+    catch (...)
+    {
+      executing = false;
+      device->setMemoryUsage(this, getMemoryByteSize(true));
+      throw;
+    }
+    executing = false;
+
+    net->allocScratch();
+    startIdleTime();
+
+    const memory::dims dims = getTensorDims(tensor);
+    desc.channels  = dims[1];
+    desc.height    = dims[2];
+    desc.width     = dims[3];
+    desc.blockSize = netBlockSize;
+    desc.byteSize  = getTensorSize(tensor) * sizeof(float);
+    return tensor->get_data_handle();
+  }
 
-    // Configure the network
+  void AutoencoderFilter::trimMemory()
+  {
+    // The weights and the history are kept
+    // With direct tensor I/O, the application accesses the tensors of the
+    // network between executions at any time, so they are never released.
+    if (net && !netDirect)
+      net->releaseScratch();
+    for (auto& preview : previews)
+    {
+      if (preview.net)
+        preview.net->releaseScratch();
+    }
+    if (sequence)
+      sequence->releaseScratch();
+  }
+
+  size_t AutoencoderFilter::getMemoryByteSize(bool residentOnly) const
+  {
+    auto getImageByteSize = [](const Image& image) -> size_t
+    {
+      return image.buffer ? image.buffer->size() : 0;
+    };
+
+    // The weights are always resident
+    size_t byteSize = 0;
+    if (net)
+      byteSize += net->getScratchByteSize(residentOnly) + net->getWeightsByteSize();
+    for (const auto& preview : previews)
+    {
+      if (preview.net)
+      {
+        byteSize += preview.net->getScratchByteSize(residentOnly) + preview.net->getWeightsByteSize();
+        byteSize += getImageByteSize(preview.color) + getImageByteSize(preview.albedo) +
+                    getImageByteSize(preview.normal) + getImageByteSize(preview.output);
+      }
+    }
+    if (sequence)
+      byteSize += sequence->getScratchByteSize(residentOnly);
+    if (temporal)
+      byteSize += temporal->getByteSize();
+    return byteSize;
+  }
+
+  size_t AutoencoderFilter::estimateMemoryByteSize()
+  {
     int inputC;
-    void* weightPtr;
+    const auto weightMap = parseTensors(getWeights(color, albedo, normal, inputC));
+
+    // The estimate includes the weights as well
+    size_t byteSize;
+    if (mayiuse(avx512_common))
+      getLayerCosts<16>(weightMap, inputC, color.width, color.height, byteSize);
+    else
+      getLayerCosts<8>(weightMap, inputC, color.width, color.height, byteSize);
+
+    if (motion)
+      byteSize += 2 * getPaddedImageByteRowStride(Format::Float3, color.width) * color.height;
+    return byteSize;
+  }
+
+  float AutoencoderFilter::getExposure(float autoExposure)
+  {
+    float exposure = autoExposure;
+
+    // Blend with the exposure of the previous frame in log space to avoid
+    // flickering in sequences
+    if (autoexposureSmoothing > 0.f && !std::isnan(prevExposure))
+      exposure = exp2(log2(exposure) * (1.f - autoexposureSmoothing) + log2(prevExposure) * autoexposureSmoothing);
+
+    prevExposure = exposure;
+    return exposure;
+  }
 
+  int AutoencoderFilter::selectPreviewScale() const
+  {
+    if (timeBudget <= 0.f || !buildPreviewNet)
+      return 0;
+
+    // Select the highest resolution which is predicted to meet the budget,
+    // trying the resolutions without a prediction first
+    for (int i = 0; i < numPreviewScales; ++i)
+    {
+      const double time = getPredictedTime(i);
+      if (std::isnan(time) || time <= timeBudget)
+        return i;
+    }
+
+    return numPreviewScales-1;
+  }
+
+  double AutoencoderFilter::getPredictedTime(int scaleIndex) const
+  {
+    if (!std::isnan(executionTimes[scaleIndex]))
+      return executionTimes[scaleIndex];
+
+    // Extrapolate from another resolution, assuming that the time is
+    // proportional to the number of pixels
+    for (int i = 0; i < numPreviewScales; ++i)
+    {
+      if (!std::isnan(executionTimes[i]))
+        return executionTimes[i] * std::pow(4., i - scaleIndex);
+    }
+
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+
+  void AutoencoderFilter::updateExecutionTime(int scaleIndex, double time)
+  {
+    double& prevTime = executionTimes[scaleIndex];
+    if (std::isnan(prevTime))
+    {
+      prevTime = time;
+      return;
+    }
+
+    // Exponential moving average to filter out noise
+    const double newTime = prevTime * 0.5 + time * 0.5;
+
+    // The change is likely caused by the load of the machine, thus the
+    // times of the other resolutions are scaled as well
+    if (prevTime > 0.)
+    {
+      const double ratio = newTime / prevTime;
+      for (int i = 0; i < numPreviewScales; ++i)
+        executionTimes[i] *= ratio;
+    }
+    prevTime = newTime;
+  }
+
+  void AutoencoderFilter::resetExecutionTimes()
+  {
+    for (int i = 0; i < numPreviewScales; ++i)
+      executionTimes[i] = std::numeric_limits<double>::quiet_NaN();
+  }
+
+  const AutoencoderFilter::Preview& AutoencoderFilter::getPreview(int scaleIndex)
+  {
+    Preview& preview = previews[scaleIndex-1];
+    if (preview.net)
+      return preview;
+
+    const int scale  = 1 << scaleIndex;
+    const int width  = (color.width  + scale - 1) / scale;
+    const int height = (color.height + scale - 1) / scale;
+
+    auto newImage = [&]()
+    {
+      size_t bytePixelStride, byteRowStride;
+      auto buffer = device->newImageBuffer(Format::Float3, width, height, bytePixelStride, byteRowStride);
+      return Image(buffer, Format::Float3, width, height, 0, bytePixelStride, byteRowStride);
+    };
+
+    preview.color = newImage();
+    if (albedo)
+      preview.albedo = newImage();
+    if (normal)
+      preview.normal = newImage();
+    preview.output = newImage();
+    preview.net = buildPreviewNet(preview);
+    return preview;
+  }
+
+  int AutoencoderFilter::prepareInput(TransferFunc& transferFunc)
+  {
+    if (!hdr)
+      return 0;
+
+    // Use the user-specified exposure if available
+    if (!std::isnan(hdrScale))
+    {
+      static_cast<HDRTransferFunc&>(transferFunc).setExposure(hdrScale);
+      return 0;
+    }
+
+    // Otherwise the exposure is estimated while reordering the input
+    return autoexposureStride;
+  }
+
+  void AutoencoderFilter::analyzeInput(const InputStats& stats, TransferFunc& transferFunc)
+  {
+    numNonFinitePixels += stats.numNonFinitePixels;
+    numNegativePixels  += stats.numNegativePixels;
+
+    if (hdr && std::isnan(hdrScale))
+      static_cast<HDRTransferFunc&>(transferFunc).setExposure(getExposure(stats.exposure));
+  }
+
+
+  void* AutoencoderFilter::getWeights(bool hasColor, bool hasAlbedo, bool hasNormal, int& inputC)
+  {
     if (srgb && hdr)
       throw Exception(Error::InvalidOperation, "srgb and hdr modes cannot be enabled at the same time");
 
-    if (color && !albedo && !normal && weightData.hdr)
+    if (hasColor && !hasAlbedo && !hasNormal && weightData.hdr)
     {
       inputC = 3;
-      weightPtr = hdr ? weightData.hdr : weightData.ldr;
+      return hdr ? weightData.hdr : weightData.ldr;
     }
-    else if (color && albedo && !normal && weightData.hdr_alb)
+    else if (hasColor && hasAlbedo && !hasNormal && weightData.hdr_alb)
     {
       inputC = 6;
-      weightPtr = hdr ? weightData.hdr_alb : weightData.ldr_alb;
+      return hdr ? weightData.hdr_alb : weightData.ldr_alb;
     }
-    else if (color && albedo && normal && weightData.hdr_alb_nrm)
+    else if (hasColor && hasAlbedo && hasNormal && weightData.hdr_alb_nrm)
     {
       inputC = 9;
-      weightPtr = hdr ? weightData.hdr_alb_nrm : weightData.ldr_alb_nrm;
+      return hdr ? weightData.hdr_alb_nrm : weightData.ldr_alb_nrm;
     }
     else
     {
       throw Exception(Error::InvalidOperation, "unsupported combination of input features");
     }
+  }
+
+  template<int K>
+  std::vector<LayerCost> AutoencoderFilter::getLayerCosts(const std::map<std::string, Tensor>& weightMap,
+                                                          int inputC, int width, int height,
+                                                          size_t& memoryByteSize)
+  {
+    // The layers are the same as in addLayers, but only their sizes are computed
+    Network<K> net(weightMap);
+    std::vector<LayerCost> costs;
+    memoryByteSize = 0;
+
+    const size_t imageByteSize = size_t(width) * height * 3 * sizeof(float);
+
+    auto addConv = [&](const std::string& name, const memory::dims& srcDims)
+    {
+      const memory::dims dstDims = net.getConvDims(name, srcDims);
+      const size_t dstByteSize = getTensorByteSize(dstDims);
+      const size_t weightsByteSize = getTensorByteSize({dstDims[1], srcDims[1], 3, 3}) + getTensorByteSize({dstDims[1]});
+      const double flops = 2. * dstDims[2] * dstDims[3] * dstDims[1] * srcDims[1] * 9;
+      costs.push_back(makeLayerCost(name, flops, double(getTensorByteSize(srcDims) + dstByteSize + weightsByteSize), dstByteSize));
+      memoryByteSize += dstByteSize + weightsByteSize;
+      return dstDims;
+    };
+
+    // Except the last one, the poolings and upsamplings store their outputs
+    // in the buffers allocated for the concats
+    auto addPool = [&](const memory::dims& srcDims, bool alloc)
+    {
+      const memory::dims dstDims = net.getPoolDims(srcDims);
+      const size_t dstByteSize = getTensorByteSize(dstDims);
+      costs.push_back(makeLayerCost("pool", 0, double(getTensorByteSize(srcDims) + dstByteSize), dstByteSize));
+      if (alloc)
+        memoryByteSize += dstByteSize;
+      return dstDims;
+    };
+
+    auto addUpsample = [&](const memory::dims& srcDims, const memory::dims& cropDims)
+    {
+      const memory::dims dstDims = net.getUpsampleDims(srcDims, cropDims);
+      const size_t dstByteSize = getTensorByteSize(dstDims);
+      costs.push_back(makeLayerCost("upsample", 0, double(getTensorByteSize(srcDims) + dstByteSize), dstByteSize));
+      memoryByteSize += getTensorByteSize(net.getConcatDims(dstDims, cropDims));
+      return net.getConcatDims(dstDims, cropDims);
+    };
+
+    const auto inputDims        = memory::dims({1, inputC, height, width});
+    const auto inputReorderDims = net.getInputReorderDims(inputDims, 1);
+    costs.push_back(makeLayerCost("input_reorder", 0, double(imageByteSize * (inputC / 3) + getTensorByteSize(inputReorderDims)),
+                                  getTensorByteSize(inputReorderDims)));
+
+    const auto conv1Dims   = addConv("conv1", inputReorderDims);
+    const auto conv1bDims  = addConv("conv1b", conv1Dims);
+    const auto pool1Dims   = addPool(conv1bDims, false);
+    const auto conv2Dims   = addConv("conv2", pool1Dims);
+    const auto pool2Dims   = addPool(conv2Dims, false);
+    const auto conv3Dims   = addConv("conv3", pool2Dims);
+    const auto pool3Dims   = addPool(conv3Dims, false);
+    const auto conv4Dims   = addConv("conv4", pool3Dims);
+    const auto pool4Dims   = addPool(conv4Dims, false);
+    const auto conv5Dims   = addConv("conv5", pool4Dims);
+    const auto pool5Dims   = addPool(conv5Dims, true);
+    const auto concat4Dims = addUpsample(pool5Dims, pool4Dims);
+    const auto conv6Dims   = addConv("conv6", concat4Dims);
+    const auto conv6bDims  = addConv("conv6b", conv6Dims);
+    const auto concat3Dims = addUpsample(conv6bDims, pool3Dims);
+    const auto conv7Dims   = addConv("conv7", concat3Dims);
+    const auto conv7bDims  = addConv("conv7b", conv7Dims);
+    const auto concat2Dims = addUpsample(conv7bDims, pool2Dims);
+    const auto conv8Dims   = addConv("conv8", concat2Dims);
+    const auto conv8bDims  = addConv("conv8b", conv8Dims);
+    const auto concat1Dims = addUpsample(conv8bDims, pool1Dims);
+    const auto conv9Dims   = addConv("conv9", concat1Dims);
+    const auto conv9bDims  = addConv("conv9b", conv9Dims);
+    const auto concat0Dims = addUpsample(conv9bDims, inputReorderDims);
+    const auto conv10Dims  = addConv("conv10", concat0Dims);
+    const auto conv10bDims = addConv("conv10b", conv10Dims);
+    const auto conv11Dims  = addConv("conv11", conv10bDims);
+
+    costs.push_back(makeLayerCost("output_reorder", 0, double(getTensorByteSize(conv11Dims) + imageByteSize), 0));
+    return costs;
+  }
+
+  template<int K>
+  std::shared_ptr<Executable> AutoencoderFilter::buildNet()
+  {
+    const int width = color.width;
+    const int height = color.height;
+
+    // Configure the network
+    int inputC;
+    void* weightPtr = getWeights(color, albedo, normal, inputC);
 
-    if (!output)
+    // With direct input, the input images only specify the size and the
+    // features, and with direct output, the output image is not used
+    if (!output && !directOutput)
       throw Exception(Error::InvalidOperation, "output image not specified");
 
     if ((color.format != Format::Float3)
         || (albedo && albedo.format != Format::Float3)
         || (normal && normal.format != Format::Float3)
-        || (output.format != Format::Float3))
+        || (output && output.format != Format::Float3))
       throw Exception(Error::InvalidOperation, "unsupported image format");
 
     if ((albedo && (albedo.width != width || albedo.height != height))
         || (normal && (normal.width != width || normal.height != height))
-        || (output.width != width || output.height != height))
+        || (output && (output.width != width || output.height != height)))
       throw Exception(Error::InvalidOperation, "image size mismatch");
 
+    if (motion && (motion.format != Format::Float2 || motion.width != width || motion.height != height))
+      throw Exception(Error::InvalidOperation, "invalid motion image");
+
+    if (motion && directOutput)
+      throw Exception(Error::InvalidOperation, "temporal blending is not supported with direct output");
+
     // Parse the weights
     const auto weightMap = parseTensors(weightPtr);
 
+    if (srgb)
+      return buildNet<K, LinearTransferFunc>(weightMap, inputC);
+    else if (hdr)
+      return buildNet<K, HDRTransferFunc>(weightMap, inputC);
+    else
+      return buildNet<K, SRGBTransferFunc>(weightMap, inputC);
+  }
+
+  template<int K, class TransferFunc>
+  std::shared_ptr<Executable> AutoencoderFilter::buildNet(const std::map<std::string, Tensor>& weightMap, int inputC)
+  {
+    auto transferFunc = std::make_shared<TransferFunc>();
+    this->transferFunc = transferFunc;
+
     // Create the network
-    std::shared_ptr<Network<K>> net = std::make_shared<Network<K>>(weightMap);
+    const bool builtinKernels = device->useBuiltinKernels();
+    std::shared_ptr<Network<K>> net = std::make_shared<Network<K>>(weightMap, builtinKernels);
+
+    // Profile the network if requested
+    profiler.reset();
+    if (device->getPerfCounters())
+    {
+      profiler = std::make_shared<Profiler>(device->getPerfCounters());
+      net->setProfiler(profiler);
+    }
+
+    addLayers(*net, inputC, color, albedo, normal, output, transferFunc, netInput, netOutput,
+              convAlgo, directInput, directOutput);
+    netInputC = inputC;
+    netBlockSize = K;
+    netDirect = directInput || directOutput;
+
+    // Without the input reorder, the padding channels must be zeroed here
+    if (directInput)
+      net->zeroTensor(netInput);
+
+    // Temporal accumulation with double-buffered history
+    temporal.reset();
+    if (motion)
+    {
+      auto newHistory = [&]()
+      {
+        size_t bytePixelStride, byteRowStride;
+        auto buffer = device->newImageBuffer(Format::Float3, output.width, output.height, bytePixelStride, byteRowStride);
+        return Image(buffer, Format::Float3, output.width, output.height, 0, bytePixelStride, byteRowStride);
+      };
+
+      temporal = std::make_shared<TemporalNode>(output, motion, newHistory(), newHistory(), temporalBlend);
+    }
+
+    // Lower resolutions and sequences are not supported with direct tensor I/O
+    if (directInput || directOutput)
+    {
+      buildPreviewNet = nullptr;
+      sequence.reset();
+      return net;
+    }
+
+    // Networks for denoising at lower resolutions, sharing the weights
+    const ConvAlgo convAlgo = this->convAlgo;
+    buildPreviewNet = [this, net, weightMap, inputC, builtinKernels, convAlgo, transferFunc](const Preview& preview)
+    {
+      auto previewNet = std::make_shared<Network<K>>(weightMap, builtinKernels);
+      previewNet->shareWeights(net);
+      std::shared_ptr<memory> previewInput, previewOutput;
+      addLayers(*previewNet, inputC, preview.color, preview.albedo, preview.normal, preview.output,
+                transferFunc, previewInput, previewOutput, convAlgo);
+      return previewNet;
+    };
+
+    if (maxBatchSize > 1)
+    {
+      // Frames are processed in batches by copies of the network sharing the weights
+      auto buildFunc = [this, net, weightMap, inputC, builtinKernels, convAlgo](const std::shared_ptr<TransferFunc>& laneTransferFunc)
+      {
+        auto lane = std::make_shared<Network<K>>(weightMap, builtinKernels);
+        lane->shareWeights(net);
+        std::shared_ptr<memory> laneInput, laneOutput;
+        addLayers(*lane, inputC, color, albedo, normal, output, laneTransferFunc, laneInput, laneOutput, convAlgo);
+        return lane;
+      };
+
+      sequence = std::make_shared<BatchPipelineImpl<K, TransferFunc>>(
+        device, net, transferFunc, buildFunc, maxBatchSize, color, albedo, normal, output, motion, temporal);
+    }
+    else
+    {
+      // Pipeline for sequences (its buffers are allocated on first use)
+      sequence = std::make_shared<SequencePipelineImpl<K, TransferFunc>>(
+        device, net, color, albedo, normal, output, motion, temporal, netInput, netOutput, this);
+    }
+
+    return net;
+  }
+
+  template<int K, class TransferFunc>
+  void AutoencoderFilter::addLayers(Network<K>& net,
+                                    int inputC,
+                                    const Image& color,
+                                    const Image& albedo,
+                                    const Image& normal,
+                                    const Image& output,
+                                    const std::shared_ptr<TransferFunc>& transferFunc,
+                                    std::shared_ptr<memory>& netInput,
+                                    std::shared_ptr<memory>& netOutput,
+                                    ConvAlgo convAlgo,
+                                    bool directInput,
+                                    bool directOutput)
+  {
+    // The network supports arbitrary image sizes thanks to ceil-mode pooling
+    // and cropped upsampling, so spatial padding is not needed
+    constexpr int spatialPad = 1;
+
+    const int width = color.width;
+    const int height = color.height;
 
     // Compute the tensor sizes
     const auto inputDims        = memory::dims({1, inputC, height, width});
-    const auto inputReorderDims = net->getInputReorderDims(inputDims, spatialPad);
-
-    const auto conv1Dims     = net->getConvDims("conv1", inputReorderDims);
-    const auto conv1bDims    = net->getConvDims("conv1b", conv1Dims);
-    const auto pool1Dims     = net->getPoolDims(conv1bDims);
-    const auto conv2Dims     = net->getConvDims("conv2", pool1Dims);
-    const auto pool2Dims     = net->getPoolDims(conv2Dims);
-    const auto conv3Dims     = net->getConvDims("conv3", pool2Dims);
-    const auto pool3Dims     = net->getPoolDims(conv3Dims);
-    const auto conv4Dims     = net->getConvDims("conv4", pool3Dims);
-    const auto pool4Dims     = net->getPoolDims(conv4Dims);
-    const auto conv5Dims     = net->getConvDims("conv5", pool4Dims);
-    const auto pool5Dims     = net->getPoolDims(conv5Dims);
-    const auto upsample4Dims = net->getUpsampleDims(pool5Dims);
-    const auto concat4Dims   = net->getConcatDims(upsample4Dims, pool4Dims);
-    const auto conv6Dims     = net->getConvDims("conv6", concat4Dims);
-    const auto conv6bDims    = net->getConvDims("conv6b", conv6Dims);
-    const auto upsample3Dims = net->getUpsampleDims(conv6bDims);
-    const auto concat3Dims   = net->getConcatDims(upsample3Dims, pool3Dims);
-    const auto conv7Dims     = net->getConvDims("conv7", concat3Dims);
-    const auto conv7bDims    = net->getConvDims("conv7b", conv7Dims);
-    const auto upsample2Dims = net->getUpsampleDims(conv7bDims);
-    const auto concat2Dims   = net->getConcatDims(upsample2Dims, pool2Dims);
-    const auto conv8Dims     = net->getConvDims("conv8", concat2Dims);
-    const auto conv8bDims    = net->getConvDims("conv8b", conv8Dims);
-    const auto upsample1Dims = net->getUpsampleDims(conv8bDims);
-    const auto concat1Dims   = net->getConcatDims(upsample1Dims, pool1Dims);
-    const auto conv9Dims     = net->getConvDims("conv9", concat1Dims);
-    const auto conv9bDims    = net->getConvDims("conv9b", conv9Dims);
-    const auto upsample0Dims = net->getUpsampleDims(conv9bDims);
-    const auto concat0Dims   = net->getConcatDims(upsample0Dims, inputReorderDims);
-    const auto conv10Dims    = net->getConvDims("conv10", concat0Dims);
-    const auto conv10bDims   = net->getConvDims("conv10b", conv10Dims);
-    const auto conv11Dims    = net->getConvDims("conv11", conv10bDims);
+    const auto inputReorderDims = net.getInputReorderDims(inputDims, spatialPad);
+
+    const auto conv1Dims     = net.getConvDims("conv1", inputReorderDims);
+    const auto conv1bDims    = net.getConvDims("conv1b", conv1Dims);
+    const auto pool1Dims     = net.getPoolDims(conv1bDims);
+    const auto conv2Dims     = net.getConvDims("conv2", pool1Dims);
+    const auto pool2Dims     = net.getPoolDims(conv2Dims);
+    const auto conv3Dims     = net.getConvDims("conv3", pool2Dims);
+    const auto pool3Dims     = net.getPoolDims(conv3Dims);
+    const auto conv4Dims     = net.getConvDims("conv4", pool3Dims);
+    const auto pool4Dims     = net.getPoolDims(conv4Dims);
+    const auto conv5Dims     = net.getConvDims("conv5", pool4Dims);
+    const auto pool5Dims     = net.getPoolDims(conv5Dims);
+    const auto upsample4Dims = net.getUpsampleDims(pool5Dims, pool4Dims);
+    const auto concat4Dims   = net.getConcatDims(upsample4Dims, pool4Dims);
+    const auto conv6Dims     = net.getConvDims("conv6", concat4Dims);
+    const auto conv6bDims    = net.getConvDims("conv6b", conv6Dims);
+    const auto upsample3Dims = net.getUpsampleDims(conv6bDims, pool3Dims);
+    const auto concat3Dims   = net.getConcatDims(upsample3Dims, pool3Dims);
+    const auto conv7Dims     = net.getConvDims("conv7", concat3Dims);
+    const auto conv7bDims    = net.getConvDims("conv7b", conv7Dims);
+    const auto upsample2Dims = net.getUpsampleDims(conv7bDims, pool2Dims);
+    const auto concat2Dims   = net.getConcatDims(upsample2Dims, pool2Dims);
+    const auto conv8Dims     = net.getConvDims("conv8", concat2Dims);
+    const auto conv8bDims    = net.getConvDims("conv8b", conv8Dims);
+    const auto upsample1Dims = net.getUpsampleDims(conv8bDims, pool1Dims);
+    const auto concat1Dims   = net.getConcatDims(upsample1Dims, pool1Dims);
+    const auto conv9Dims     = net.getConvDims("conv9", concat1Dims);
+    const auto conv9bDims    = net.getConvDims("conv9b", conv9Dims);
+    const auto upsample0Dims = net.getUpsampleDims(conv9bDims, inputReorderDims);
+    const auto concat0Dims   = net.getConcatDims(upsample0Dims, inputReorderDims);
+    const auto conv10Dims    = net.getConvDims("conv10", concat0Dims);
+    const auto conv10bDims   = net.getConvDims("conv10b", conv10Dims);
+    const auto conv11Dims    = net.getConvDims("conv11", conv10bDims);
 
     const auto outputDims = memory::dims({1, 3, height, width});
 
@@ -193,140 +866,115 @@ namespace oidn {
     // half to hold the previous conv output and the second half to hold the
     // pool/orig image output. This works because everything is C dimension
     // outermost, padded to K floats, and all the concats are on the C dimension.
-    auto concat0Dst = net->allocTensor(concat0Dims);
-    auto concat1Dst = net->allocTensor(concat1Dims);
-    auto concat2Dst = net->allocTensor(concat2Dims);
-    auto concat3Dst = net->allocTensor(concat3Dims);
-    auto concat4Dst = net->allocTensor(concat4Dims);
+    auto concat0Dst = net.allocTensor(concat0Dims);
+    auto concat1Dst = net.allocTensor(concat1Dims);
+    auto concat2Dst = net.allocTensor(concat2Dims);
+    auto concat3Dst = net.allocTensor(concat3Dims);
+    auto concat4Dst = net.allocTensor(concat4Dims);
 
     // Input reorder
-    auto inputReorderDst = net->castTensor(inputReorderDims, concat0Dst, upsample0Dims);
-    std::shared_ptr<Node> inputReorder;
-    if (srgb)
-    {
-      transferFunc = std::make_shared<LinearTransferFunc>();
-      inputReorder = net->addInputReorder(color, albedo, normal,
-                                          std::static_pointer_cast<LinearTransferFunc>(transferFunc),
-                                          spatialPad, inputReorderDst);
-    }
-    else if (hdr)
-    {
-      transferFunc = std::make_shared<HDRTransferFunc>();
-      inputReorder = net->addInputReorder(color, albedo, normal,
-                                          std::static_pointer_cast<HDRTransferFunc>(transferFunc),
-                                          spatialPad, inputReorderDst);
-    }
-    else
-    {
-      transferFunc = std::make_shared<SRGBTransferFunc>();
-      inputReorder = net->addInputReorder(color, albedo, normal,
-                                          std::static_pointer_cast<SRGBTransferFunc>(transferFunc),
-                                          spatialPad, inputReorderDst);
-    }
+    netInput = net.castTensor(inputReorderDims, concat0Dst, upsample0Dims);
+    if (!directInput)
+      net.addInputReorder(color, albedo, normal, transferFunc, spatialPad, netInput, this);
 
     // conv1
-    auto conv1 = net->addConv("conv1", inputReorder->getDst());
+    auto conv1 = net.addConv("conv1", netInput, true, convAlgo);
 
     // conv1b
-    auto conv1b = net->addConv("conv1b", conv1->getDst());
+    auto conv1b = net.addConv("conv1b", conv1->getDst(), true, convAlgo);
 
     // pool1
     // Adjust pointer for pool1 to eliminate concat1
-    auto pool1Dst = net->castTensor(pool1Dims, concat1Dst, upsample1Dims);
-    auto pool1 = net->addPool(conv1b->getDst(), pool1Dst);
+    auto pool1Dst = net.castTensor(pool1Dims, concat1Dst, upsample1Dims);
+    auto pool1 = net.addPool(conv1b->getDst(), pool1Dst);
 
     // conv2
-    auto conv2 = net->addConv("conv2", pool1->getDst());
+    auto conv2 = net.addConv("conv2", pool1->getDst(), true, convAlgo);
 
     // pool2
     // Adjust pointer for pool2 to eliminate concat2
-    auto pool2Dst = net->castTensor(pool2Dims, concat2Dst, upsample2Dims);
-    auto pool2 = net->addPool(conv2->getDst(), pool2Dst);
+    auto pool2Dst = net.castTensor(pool2Dims, concat2Dst, upsample2Dims);
+    auto pool2 = net.addPool(conv2->getDst(), pool2Dst);
 
     // conv3
-    auto conv3 = net->addConv("conv3", pool2->getDst());
+    auto conv3 = net.addConv("conv3", pool2->getDst(), true, convAlgo);
 
     // pool3
     // Adjust pointer for pool3 to eliminate concat3
-    auto pool3Dst = net->castTensor(pool3Dims, concat3Dst, upsample3Dims);
-    auto pool3 = net->addPool(conv3->getDst(), pool3Dst);
+    auto pool3Dst = net.castTensor(pool3Dims, concat3Dst, upsample3Dims);
+    auto pool3 = net.addPool(conv3->getDst(), pool3Dst);
 
     // conv4
-    auto conv4 = net->addConv("conv4", pool3->getDst());
+    auto conv4 = net.addConv("conv4", pool3->getDst(), true, convAlgo);
 
     // pool4
     // Adjust pointer for pool4 to eliminate concat4
-    auto pool4Dst = net->castTensor(pool4Dims, concat4Dst, upsample4Dims);
-    auto pool4 = net->addPool(conv4->getDst(), pool4Dst);
+    auto pool4Dst = net.castTensor(pool4Dims, concat4Dst, upsample4Dims);
+    auto pool4 = net.addPool(conv4->getDst(), pool4Dst);
 
     // conv5
-    auto conv5 = net->addConv("conv5", pool4->getDst());
+    auto conv5 = net.addConv("conv5", pool4->getDst(), true, convAlgo);
 
     // pool5
-    auto pool5 = net->addPool(conv5->getDst());
+    auto pool5 = net.addPool(conv5->getDst());
 
     // upsample4
-    auto upsample4Dst = net->castTensor(upsample4Dims, concat4Dst);
-    auto upsample4 = net->addUpsample(pool5->getDst(), upsample4Dst);
+    auto upsample4Dst = net.castTensor(upsample4Dims, concat4Dst);
+    auto upsample4 = net.addUpsample(pool5->getDst(), upsample4Dst);
 
     // conv6
-    auto conv6 = net->addConv("conv6", concat4Dst);
+    auto conv6 = net.addConv("conv6", concat4Dst, true, convAlgo);
 
     // conv6b
-    auto conv6b = net->addConv("conv6b", conv6->getDst());
+    auto conv6b = net.addConv("conv6b", conv6->getDst(), true, convAlgo);
 
     // upsample3
-    auto upsample3Dst = net->castTensor(upsample3Dims, concat3Dst);
-    auto upsample3 = net->addUpsample(conv6b->getDst(), upsample3Dst);
+    auto upsample3Dst = net.castTensor(upsample3Dims, concat3Dst);
+    auto upsample3 = net.addUpsample(conv6b->getDst(), upsample3Dst);
 
     // conv7
-    auto conv7 = net->addConv("conv7", concat3Dst);
+    auto conv7 = net.addConv("conv7", concat3Dst, true, convAlgo);
 
     // conv7b
-    auto conv7b = net->addConv("conv7b", conv7->getDst());
+    auto conv7b = net.addConv("conv7b", conv7->getDst(), true, convAlgo);
 
     // upsample2
-    auto upsample2Dst = net->castTensor(upsample2Dims, concat2Dst);
-    auto upsample2 = net->addUpsample(conv7b->getDst(), upsample2Dst);
+    auto upsample2Dst = net.castTensor(upsample2Dims, concat2Dst);
+    auto upsample2 = net.addUpsample(conv7b->getDst(), upsample2Dst);
 
     // conv8
-    auto conv8 = net->addConv("conv8", concat2Dst);
+    auto conv8 = net.addConv("conv8", concat2Dst, true, convAlgo);
 
     // conv8b
-    auto conv8b = net->addConv("conv8b", conv8->getDst());
+    auto conv8b = net.addConv("conv8b", conv8->getDst(), true, convAlgo);
 
     // upsample1
-    auto upsample1Dst = net->castTensor(upsample1Dims, concat1Dst);
-    auto upsample1 = net->addUpsample(conv8b->getDst(), upsample1Dst);
+    auto upsample1Dst = net.castTensor(upsample1Dims, concat1Dst);
+    auto upsample1 = net.addUpsample(conv8b->getDst(), upsample1Dst);
 
     // conv9
-    auto conv9 = net->addConv("conv9", concat1Dst);
+    auto conv9 = net.addConv("conv9", concat1Dst, true, convAlgo);
 
     // conv9b
-    auto conv9b = net->addConv("conv9b", conv9->getDst());
+    auto conv9b = net.addConv("conv9b", conv9->getDst(), true, convAlgo);
 
     // upsample0
-    auto upsample0Dst = net->castTensor(upsample0Dims, concat0Dst);
-    auto upsample0 = net->addUpsample(conv9b->getDst(), upsample0Dst);
+    auto upsample0Dst = net.castTensor(upsample0Dims, concat0Dst);
+    auto upsample0 = net.addUpsample(conv9b->getDst(), upsample0Dst);
 
     // conv10
-    auto conv10 = net->addConv("conv10", concat0Dst);
+    auto conv10 = net.addConv("conv10", concat0Dst, true, convAlgo);
 
     // conv10b
-    auto conv10b = net->addConv("conv10b", conv10->getDst());
+    auto conv10b = net.addConv("conv10b", conv10->getDst(), true, convAlgo);
 
     // conv11
-    auto conv11 = net->addConv("conv11", conv10b->getDst(), false /* no relu */);
+    auto conv11 = net.addConv("conv11", conv10b->getDst(), false /* no relu */, convAlgo);
 
     // Output reorder
-    if (srgb)
-      net->addOutputReorder(conv11->getDst(), std::static_pointer_cast<LinearTransferFunc>(transferFunc), output);
-    else if (hdr)
-      net->addOutputReorder(conv11->getDst(), std::static_pointer_cast<HDRTransferFunc>(transferFunc), output);
-    else
-      net->addOutputReorder(conv11->getDst(), std::static_pointer_cast<SRGBTransferFunc>(transferFunc), output);
-
-    return net;
+    netOutput = conv11->getDst();
+    if (!directOutput)
+      net.addOutputReorder(netOutput, transferFunc, output);
   }
 
   // --------------------------------------------------------------------------
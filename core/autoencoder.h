@@ -18,7 +18,11 @@
 
 #include "filter.h"
 #include "network.h"
+#include "sequence.h"
 #include "tone_mapping.h"
+#include "resample.h"
+#include "cost_model.h"
+#include <functional>
 
 namespace oidn {
 
@@ -26,18 +30,69 @@ namespace oidn {
   // AutoencoderFilter - Direct-predicting autoencoder
   // --------------------------------------------------------------------------
 
-  class AutoencoderFilter : public Filter
+  class AutoencoderFilter : public Filter, public InputAnalyzer
   {
   private:
     Image color;
     Image albedo;
     Image normal;
     Image output;
+    Image motion;
     bool hdr = false;
     bool srgb = false;
+    int maxBatchSize = 1; // maximum number of frames of a sequence executed layer by layer
+    ConvAlgo convAlgo = ConvAlgo::Auto;
 
-    std::shared_ptr<Node> net;
+    // Direct tensor I/O: the caller writes the input tensor and/or reads the
+    // output tensor of the network, and the reorders are skipped
+    bool directInput = false;
+    bool directOutput = false;
+    std::shared_ptr<memory> netInput;  // input tensor of the first convolution
+    std::shared_ptr<memory> netOutput; // output tensor of the last convolution
+    int netInputC = 0;                 // number of input channels before padding
+    int netBlockSize = 0;              // channel block size of the tensors (K)
+    bool netDirect = false;            // the committed network uses direct tensor I/O (never trimmed)
+
+    // Exposure of HDR images
+    float hdrScale = std::numeric_limits<float>::quiet_NaN(); // computed automatically if NaN
+    int autoexposureStride = 1;       // row sampling stride of autoexposure
+    float autoexposureSmoothing = 0;  // weight of the previous exposure, in [0, 1)
+    float prevExposure = std::numeric_limits<float>::quiet_NaN();
+
+    // Adaptive quality: if the execution at full resolution is predicted to
+    // exceed the time budget, the image is denoised at a lower resolution
+    static constexpr int numPreviewScales = 3; // downscaling factors 1, 2 and 4
+    float timeBudget = 0;  // maximum execution time in milliseconds (unlimited if 0)
+    int previewScale = 1;  // downscaling factor of the last execution
+    double executionTimes[numPreviewScales]; // average measured execution times in milliseconds (NaN if unknown)
+
+    // Network and images for denoising at a lower resolution
+    struct Preview
+    {
+      Image color;
+      Image albedo;
+      Image normal;
+      Image output;
+      std::shared_ptr<Executable> net;
+    };
+
+    Preview previews[numPreviewScales-1]; // downscaled by 2 and 4, allocated on first use
+    std::function<std::shared_ptr<Executable>(const Preview&)> buildPreviewNet;
+
+    // Temporal accumulation of sequences (enabled if motion vectors are set)
+    float temporalBlend = 0.8f; // weight of the reprojected history
+    bool resetHistory = false;  // the next frame is not blended with the history
+    std::shared_ptr<TemporalNode> temporal;
+
+    // Diagnostics of the input images of the last execution (sum over all
+    // frames, which may exceed the range of int for long sequences)
+    std::atomic<int64_t> numNonFinitePixels;
+    std::atomic<int64_t> numNegativePixels;
+
+    std::shared_ptr<Executable> net;
     std::shared_ptr<TransferFunc> transferFunc;
+    std::shared_ptr<SequencePipeline> sequence;
+    std::shared_ptr<Profiler> profiler;
 
     bool dirty = true;
 
@@ -58,14 +113,60 @@ namespace oidn {
     void setImage(const std::string& name, const Image& data) override;
     void set1i(const std::string& name, int value) override;
     int get1i(const std::string& name) override;
+    void set1f(const std::string& name, float value) override;
+    float get1f(const std::string& name) override;
+    std::vector<LayerCost> estimateCost(int width, int height, bool hasAlbedo, bool hasNormal,
+                                        int numThreads, size_t& memoryByteSize) override;
     void commit() override;
     void execute() override;
+    void executeSequence(const Frame* frames, size_t numFrames) override;
+    void* getTensor(const std::string& name, TensorDesc& desc) override;
+
+  protected:
+    void trimMemory() override;
+    size_t getMemoryByteSize(bool residentOnly) const override;
 
   private:
+    void* getWeights(bool hasColor, bool hasAlbedo, bool hasNormal, int& inputC);
+    size_t estimateMemoryByteSize();
+
     template<int K>
-    std::shared_ptr<Node> buildNet();
+    std::vector<LayerCost> getLayerCosts(const std::map<std::string, Tensor>& weightMap,
+                                         int inputC, int width, int height,
+                                         size_t& memoryByteSize);
+
+    template<int K>
+    std::shared_ptr<Executable> buildNet();
+
+    template<int K, class TransferFunc>
+    std::shared_ptr<Executable> buildNet(const std::map<std::string, Tensor>& weightMap, int inputC);
+
+    template<int K, class TransferFunc>
+    void addLayers(Network<K>& net,
+                   int inputC,
+                   const Image& color,
+                   const Image& albedo,
+                   const Image& normal,
+                   const Image& output,
+                   const std::shared_ptr<TransferFunc>& transferFunc,
+                   std::shared_ptr<memory>& netInput,
+                   std::shared_ptr<memory>& netOutput,
+                   ConvAlgo convAlgo,
+                   bool directInput = false,
+                   bool directOutput = false);
 
     bool isCommitted() const { return bool(net); }
+
+    float getExposure(float autoExposure);
+
+    int selectPreviewScale() const;
+    double getPredictedTime(int scaleIndex) const;
+    void updateExecutionTime(int scaleIndex, double time);
+    void resetExecutionTimes();
+    const Preview& getPreview(int scaleIndex);
+
+    int prepareInput(TransferFunc& transferFunc) override;
+    void analyzeInput(const InputStats& stats, TransferFunc& transferFunc) override;
   };
 
   // --------------------------------------------------------------------------
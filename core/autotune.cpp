@@ -0,0 +1,300 @@
+// ======================================================================== //
+// Copyright 2009-2019 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "autotune.h"
+#include "network.h"
+#include "common/timer.h"
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#if defined(_WIN32)
+  #include <process.h>
+#else
+  #include <unistd.h>
+#endif
+
+namespace oidn {
+
+  std::ostream& operator <<(std::ostream& sm, const ThreadConfig& config)
+  {
+    sm << config.numThreads << " threads (";
+    if (config.setAffinity)
+    {
+      if (config.numThreadsPerCore > 0)
+        sm << "affinitized, " << config.numThreadsPerCore << " per core";
+      else
+        sm << "affinitized, all hardware threads";
+    }
+    else
+      sm << "non-affinitized";
+    sm << ")";
+    return sm;
+  }
+
+  namespace
+  {
+    // Returns the number of hardware threads which can be pinned with the
+    // specified number of threads per core (0 if unknown)
+    int getNumPinnedThreads(int numThreadsPerCore)
+    {
+      return ThreadAffinity(numThreadsPerCore > 0 ? numThreadsPerCore : INT_MAX).getNumThreads();
+    }
+
+    std::vector<ThreadConfig> getThreadConfigCandidates(int maxNumThreads)
+    {
+      const int numCores = getNumPinnedThreads(1);
+      const int numPinnedThreads = getNumPinnedThreads(0);
+      const int numHardwareThreads = tbb::this_task_arena::max_concurrency();
+
+      std::vector<ThreadConfig> candidates;
+
+      auto addCandidate = [&](int numThreads, int numThreadsPerCore, bool setAffinity)
+      {
+        ThreadConfig config;
+        config.numThreads = (maxNumThreads > 0) ? min(numThreads, maxNumThreads) : numThreads;
+        config.numThreadsPerCore = numThreadsPerCore;
+        config.setAffinity = setAffinity;
+
+        if (config.numThreads >= 1 && std::find(candidates.begin(), candidates.end(), config) == candidates.end())
+          candidates.push_back(config);
+      };
+
+      // The first candidate is the default configuration
+      if (numCores > 0)
+      {
+        addCandidate(numCores, 1, true);           // one pinned thread per core
+        addCandidate(numPinnedThreads, 0, true);   // pinned threads on all hardware threads (SMT)
+        addCandidate(numCores / 2, 1, true);       // half of the cores (may be faster if memory-bound)
+      }
+      addCandidate(numHardwareThreads, 1, false);  // unpinned threads on all hardware threads
+      if (numCores > 0)
+        addCandidate(numCores, 1, false);          // unpinned threads, as many as cores
+
+      return candidates;
+    }
+
+    // Returns the minimum execution time of the synthetic network in seconds
+    template<int K>
+    double measureThreadConfig(const ThreadConfig& config, bool builtinKernels)
+    {
+      // Typical layers of the autoencoder: convolution, pooling, and
+      // convolution at the lower resolution
+      const int C = 64;
+      const int H = 256;
+      const int W = 256;
+      const int numRuns = 3;
+
+      Tensor weights({C, C, 3, 3}, "oihw");
+      Tensor bias({C}, "x");
+      std::fill(weights.data, weights.data + weights.size(), 0.01f);
+      std::fill(bias.data, bias.data + bias.size(), 0.f);
+
+      std::map<std::string, Tensor> weightMap;
+      weightMap["tune0/W"] = weights;
+      weightMap["tune0/b"] = bias;
+      weightMap["tune1/W"] = weights;
+      weightMap["tune1/b"] = bias;
+
+      tbb::task_arena arena(config.numThreads);
+
+      std::shared_ptr<PinningObserver> observer;
+      if (config.setAffinity)
+      {
+        auto affinity = std::make_shared<ThreadAffinity>(config.numThreadsPerCore > 0 ? config.numThreadsPerCore : INT_MAX);
+        if (affinity->getNumThreads() > 0)
+          observer = std::make_shared<PinningObserver>(affinity, arena);
+      }
+
+      double minTime = std::numeric_limits<double>::infinity();
+
+      arena.execute([&]()
+      {
+        Network<K> net(weightMap, builtinKernels);
+        auto src = net.allocTensor({1, C, H, W});
+        net.zeroTensor(src);
+        auto conv0 = net.addConv("tune0", src);
+        auto pool  = net.addPool(conv0->getDst());
+        net.addConv("tune1", pool->getDst());
+
+        net.execute(); // warm up
+
+        for (int i = 0; i < numRuns; ++i)
+        {
+          Timer timer;
+          net.execute();
+          minTime = min(minTime, timer.query());
+        }
+      });
+
+      observer.reset(); // stop observing before the arena is destroyed
+      return minTime;
+    }
+
+    double measureThreadConfig(const ThreadConfig& config, bool builtinKernels)
+    {
+      if (mayiuse(avx512_common))
+        return measureThreadConfig<16>(config, builtinKernels);
+      else
+        return measureThreadConfig<8>(config, builtinKernels);
+    }
+
+    // Returns the path of the cache file (empty if unknown)
+    std::string getCacheFilePath()
+    {
+      if (const char* path = getenv("OIDN_AUTOTUNE_CACHE"))
+        return path;
+
+    #if defined(_WIN32)
+      if (const char* dir = getenv("LOCALAPPDATA"))
+        return std::string(dir) + "\\oidn_autotune.txt";
+    #else
+      if (const char* dir = getenv("XDG_CACHE_HOME"))
+        return std::string(dir) + "/oidn_autotune.txt";
+      if (const char* dir = getenv("HOME"))
+        return std::string(dir) + "/.cache/oidn_autotune.txt";
+    #endif
+
+      return "";
+    }
+  }
+
+  std::string getMachineFingerprint(int maxNumThreads, bool builtinKernels)
+  {
+    std::stringstream sm;
+    sm << getCPUName()
+       << "|cores=" << getNumPinnedThreads(1)
+       << "|threads=" << tbb::this_task_arena::max_concurrency()
+       << "|maxThreads=" << maxNumThreads
+       << "|isa=" << (mayiuse(avx512_common) ? "AVX-512" : (mayiuse(avx2) ? "AVX2" : "SSE4.1"))
+       << "|kernels=" << (builtinKernels ? "built-in" : "MKL-DNN")
+       << "|version=" << OIDN_VERSION_MAJOR << "." << OIDN_VERSION_MINOR << "." << OIDN_VERSION_PATCH;
+
+    // The fingerprint is the key of a line in the cache file
+    std::string fingerprint = sm.str();
+    std::replace(fingerprint.begin(), fingerprint.end(), '\t', ' ');
+    std::replace(fingerprint.begin(), fingerprint.end(), '\n', ' ');
+    return fingerprint;
+  }
+
+  ThreadConfig tuneThreadConfig(int maxNumThreads, bool builtinKernels, int verbose)
+  {
+    const std::vector<ThreadConfig> candidates = getThreadConfigCandidates(maxNumThreads);
+
+    ThreadConfig bestConfig = candidates[0];
+    double bestTime = std::numeric_limits<double>::infinity();
+
+    for (const ThreadConfig& config : candidates)
+    {
+      const double time = measureThreadConfig(config, builtinKernels);
+      if (verbose >= 1)
+        std::cout << "  Autotune: " << config << ": " << time * 1000. << " ms" << std::endl;
+
+      // Prefer the earlier candidates if the difference is within the noise
+      if (time < bestTime * 0.97)
+      {
+        bestConfig = config;
+        bestTime = time;
+      }
+    }
+
+    return bestConfig;
+  }
+
+  bool loadThreadConfig(const std::string& fingerprint, ThreadConfig& config)
+  {
+    const std::string path = getCacheFilePath();
+    if (path.empty())
+      return false;
+
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+      if (line.compare(0, fingerprint.size() + 1, fingerprint + '\t') != 0)
+        continue;
+
+      std::istringstream values(line.substr(fingerprint.size() + 1));
+      ThreadConfig result;
+      int setAffinity = 0;
+      if (!(values >> result.numThreads >> result.numThreadsPerCore >> setAffinity) ||
+          result.numThreads < 1 || result.numThreadsPerCore < 0)
+        return false;
+
+      result.setAffinity = setAffinity;
+      config = result;
+      return true;
+    }
+
+    return false;
+  }
+
+  bool saveThreadConfig(const std::string& fingerprint, const ThreadConfig& config)
+  {
+    const std::string path = getCacheFilePath();
+    if (path.empty())
+      return false;
+
+    // Keep the configurations of the other machines (e.g. sharing the home directory)
+    std::vector<std::string> lines;
+    {
+      std::ifstream file(path);
+      std::string line;
+      while (std::getline(file, line))
+      {
+        if (line.compare(0, fingerprint.size() + 1, fingerprint + '\t') != 0)
+          lines.push_back(line);
+      }
+    }
+
+    std::stringstream sm;
+    sm << fingerprint << '\t' << config.numThreads << ' ' << config.numThreadsPerCore << ' ' << int(config.setAffinity);
+    lines.push_back(sm.str());
+
+    // Write a temporary file first and replace the cache file with it, so
+    // concurrent readers (e.g. other processes) never see a partial file
+  #if defined(_WIN32)
+    const std::string tempPath = path + "." + std::to_string(_getpid()) + ".tmp";
+  #else
+    const std::string tempPath = path + "." + std::to_string(getpid()) + ".tmp";
+  #endif
+
+    {
+      std::ofstream file(tempPath, std::ios::trunc);
+      for (const std::string& line : lines)
+        file << line << '\n';
+      file.close();
+      if (!file)
+      {
+        std::remove(tempPath.c_str());
+        return false;
+      }
+    }
+
+  #if defined(_WIN32)
+    // rename fails on Windows if the destination exists
+    const bool renamed = MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+  #else
+    const bool renamed = std::rename(tempPath.c_str(), path.c_str()) == 0;
+  #endif
+
+    if (!renamed)
+      std::remove(tempPath.c_str());
+    return renamed;
+  }
+
+} // namespace oidn
@@ -0,0 +1,57 @@
+// ======================================================================== //
+// Copyright 2009-2019 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "common.h"
+
+namespace oidn {
+
+  // Configuration of the threads executing the filters of a device
+  struct ThreadConfig
+  {
+    int numThreads = 0;        // number of threads
+    int numThreadsPerCore = 1; // number of threads pinned to each core (all hardware threads if 0)
+    bool setAffinity = true;   // pin the threads to the cores
+
+    bool operator ==(const ThreadConfig& other) const
+    {
+      return numThreads == other.numThreads &&
+             numThreadsPerCore == other.numThreadsPerCore &&
+             setAffinity == other.setAffinity;
+    }
+  };
+
+  std::ostream& operator <<(std::ostream& sm, const ThreadConfig& config);
+
+  // Returns a string identifying the CPU, the available hardware threads and
+  // the library build, which determine the fastest thread configuration
+  std::string getMachineFingerprint(int maxNumThreads, bool builtinKernels);
+
+  // Measures the execution time of a synthetic network with the candidate
+  // thread configurations using at most maxNumThreads threads (unlimited if
+  // 0), and returns the fastest configuration
+  ThreadConfig tuneThreadConfig(int maxNumThreads, bool builtinKernels, int verbose);
+
+  // Loads the tuned thread configuration of a machine from the cache file
+  // Returns false if the machine was not found in the cache.
+  bool loadThreadConfig(const std::string& fingerprint, ThreadConfig& config);
+
+  // Stores the tuned thread configuration of a machine in the cache file
+  // Returns false if the cache file could not be written.
+  bool saveThreadConfig(const std::string& fingerprint, const ThreadConfig& config);
+
+} // namespace oidn
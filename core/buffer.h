@@ -29,19 +29,22 @@ namespace oidn {
   private:
     char* ptr;
     size_t byteSize;
+    size_t imageByteRowStride; // row stride of the images stored in the buffer (0 if not an image buffer)
     bool shared;
     Ref<Device> device;
 
   public:
-    __forceinline Buffer(const Ref<Device>& device, size_t size)
+    __forceinline Buffer(const Ref<Device>& device, size_t size, size_t imageByteRowStride = 0)
       : ptr((char*)alignedMalloc(size, 64)),
         byteSize(size),
+        imageByteRowStride(imageByteRowStride),
         shared(false),
         device(device) {}
 
     __forceinline Buffer(const Ref<Device>& device, void* data, size_t size)
       : ptr((char*)data),
         byteSize(size),
+        imageByteRowStride(0),
         shared(true),
         device(device)
     {
@@ -59,6 +62,10 @@ namespace oidn {
     __forceinline const char* data() const { return ptr; }
     __forceinline size_t size() const { return byteSize; }
 
+    // Returns the row stride of the images if the buffer was allocated for
+    // images with padded rows, otherwise 0
+    __forceinline size_t getImageByteRowStride() const { return imageByteRowStride; }
+
     void* map(size_t offset, size_t size)
     {
       if (offset + size > byteSize)
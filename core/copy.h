@@ -0,0 +1,61 @@
+// ======================================================================== //
+// Copyright 2009-2019 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "node.h"
+
+namespace oidn {
+
+  // Tensor copy node
+  class CopyNode : public Node
+  {
+  private:
+    std::shared_ptr<memory> src;
+    std::shared_ptr<memory> dst;
+
+  public:
+    CopyNode(const std::shared_ptr<memory>& src,
+             const std::shared_ptr<memory>& dst)
+      : src(src),
+        dst(dst)
+    {
+      assert(getTensorDims(src) == getTensorDims(dst));
+      assert(getTensorType(src) == memory::data_type::f32);
+      assert(getTensorType(dst) == memory::data_type::f32);
+    }
+
+    void execute() override
+    {
+      const float* srcPtr = (float*)src->get_data_handle();
+      float* dstPtr = (float*)dst->get_data_handle();
+
+      const size_t size = getTensorSize(src);
+      const size_t blockSize = 16384;
+      const int numBlocks = int((size + blockSize - 1) / blockSize);
+
+      parallel_nd(numBlocks, [&](int i)
+      {
+        const size_t begin = i * blockSize;
+        const size_t end = min(begin + blockSize, size);
+        memcpy(dstPtr + begin, srcPtr + begin, (end - begin) * sizeof(float));
+      });
+    }
+
+    std::shared_ptr<memory> getDst() const override { return dst; }
+  };
+
+} // namespace oidn
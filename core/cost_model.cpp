@@ -0,0 +1,112 @@
+// ======================================================================== //
+// Copyright 2009-2019 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "cost_model.h"
+#include "device.h"
+#include "network.h"
+#include "copy.h"
+#include "common/timer.h"
+#include <cstring>
+
+namespace oidn {
+
+  namespace
+  {
+    // Returns the minimum execution time of a node in seconds
+    double measureNode(Node& node, int numRuns)
+    {
+      node.execute(); // warm up
+
+      double minTime = std::numeric_limits<double>::infinity();
+      for (int i = 0; i < numRuns; ++i)
+      {
+        Timer timer;
+        node.execute();
+        minTime = min(minTime, timer.query());
+      }
+      return minTime;
+    }
+
+    template<int K>
+    Throughput measureThroughput(Device* device)
+    {
+      // Convolution with a typical number of channels
+      const int C = 64;
+      const int H = 128;
+      const int W = 128;
+
+      Tensor weights({C, C, 3, 3}, "oihw");
+      Tensor bias({C}, "x");
+      std::fill(weights.data, weights.data + weights.size(), 0.01f);
+      std::fill(bias.data, bias.data + bias.size(), 0.f);
+
+      std::map<std::string, Tensor> weightMap;
+      weightMap["calib/W"] = weights;
+      weightMap["calib/b"] = bias;
+
+      Throughput throughput;
+
+      device->executeTask([&]()
+      {
+        Network<K> net(weightMap, device->useBuiltinKernels());
+        auto convSrc = net.allocTensor({1, C, H, W});
+        net.zeroTensor(convSrc);
+        auto conv = net.addConv("calib", convSrc);
+
+        // Copy larger than the last level cache
+        const memory::dims copyDims = {1, K, 1024, 1024};
+        auto copySrc = net.allocTensor(copyDims);
+        auto copyDst = net.allocTensor(copyDims);
+        net.zeroTensor(copySrc);
+        CopyNode copy(copySrc, copyDst);
+
+        throughput.flopRate   = 2 * conv->getWorkAmount() / measureNode(*conv, 3);
+        throughput.byteRate   = 2 * getTensorByteSize(copyDims) / measureNode(copy, 3);
+        throughput.numThreads = tbb::this_task_arena::max_concurrency();
+      });
+
+      return throughput;
+    }
+  }
+
+  Throughput measureThroughput(Device* device)
+  {
+    if (mayiuse(avx512_common))
+      return measureThroughput<16>(device);
+    else
+      return measureThroughput<8>(device);
+  }
+
+  LayerCost makeLayerCost(const std::string& name, double flops, double bytes, size_t byteSize)
+  {
+    LayerCost cost;
+    memset(&cost, 0, sizeof(cost));
+    strncpy(cost.name, name.c_str(), sizeof(cost.name) - 1);
+    cost.flops = flops;
+    cost.bytes = bytes;
+    cost.byteSize = byteSize;
+    return cost;
+  }
+
+  double estimateTime(const LayerCost& cost, const Throughput& throughput, int numThreads)
+  {
+    const double flopRate = throughput.flopRate * numThreads / throughput.numThreads;
+    const double computeTime = (flopRate > 0) ? (cost.flops / flopRate) : 0;
+    const double memoryTime  = (throughput.byteRate > 0) ? (cost.bytes / throughput.byteRate) : 0;
+    return max(computeTime, memoryTime);
+  }
+
+} // namespace oidn
@@ -0,0 +1,54 @@
+// ======================================================================== //
+// Copyright 2009-2019 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "common.h"
+
+namespace oidn {
+
+  class Device;
+
+  // Attainable compute and memory throughput of a device
+  struct Throughput
+  {
+    double flopRate = 0; // floating-point operations per second
+    double byteRate = 0; // bytes read and written per second
+    int numThreads = 1;  // number of threads used for the measurement
+  };
+
+  // Measures the throughput of a device by running a convolution and a copy
+  // of a tensor which does not fit into the caches
+  // The device mutex must be locked by the caller.
+  Throughput measureThroughput(Device* device);
+
+  // Returns the size of a tensor in bytes
+  inline size_t getTensorByteSize(const memory::dims& dims)
+  {
+    size_t size = sizeof(float);
+    for (size_t i = 0; i < dims.size(); ++i)
+      size *= dims[i];
+    return size;
+  }
+
+  LayerCost makeLayerCost(const std::string& name, double flops, double bytes, size_t byteSize);
+
+  // Estimates the execution time of a layer with the roofline model
+  // The compute throughput is assumed to scale linearly with the number of
+  // threads, while the memory throughput is assumed to be saturated.
+  double estimateTime(const LayerCost& cost, const Throughput& throughput, int numThreads);
+
+} // namespace oidn
@@ -16,6 +16,8 @@
 
 #include "device.h"
 #include "autoencoder.h"
+#include "cost_model.h"
+#include "autotune.h"
 
 namespace oidn {
 
@@ -29,7 +31,18 @@ namespace oidn {
 
   Device::~Device()
   {
-    observer.reset();
+    if (trimThread.joinable())
+    {
+      {
+        // Do NOT lock the device mutex because the caller may hold it
+        std::lock_guard<std::mutex> lock(trimMutex);
+        trimExit = true;
+      }
+      trimCond.notify_all();
+      trimThread.join();
+    }
+
+    observers.clear();
   }
 
   void Device::setError(Device* device, Error code, const std::string& message)
@@ -103,6 +116,20 @@ namespace oidn {
       return numThreads;
     else if (name == "setAffinity")
       return setAffinity;
+    else if (name == "numThreadsPerCore")
+      return numThreadsPerCore;
+    else if (name == "autotune")
+      return autotune;
+    else if (name == "verbose")
+      return verbose;
+    else if (name == "builtinKernels")
+      return builtinKernels;
+    else if (name == "callerThread")
+      return callerThread;
+    else if (name == "memoryBudget")
+      return int(memoryBudget / (1024*1024));
+    else if (name == "memoryPolicy")
+      return int(memoryPolicy);
     else if (name == "version")
       return OIDN_VERSION;
     else if (name == "versionMajor")
@@ -121,6 +148,38 @@ namespace oidn {
       numThreads = value;
     else if (name == "setAffinity")
       setAffinity = value;
+    else if (name == "numThreadsPerCore")
+    {
+      if (value < 0)
+        throw Exception(Error::InvalidArgument, "invalid number of threads per core");
+      numThreadsPerCore = value;
+    }
+    else if (name == "autotune")
+      autotune = value;
+    else if (name == "verbose")
+      verbose = value;
+    else if (name == "builtinKernels")
+      builtinKernels = value;
+    else if (name == "callerThread")
+      callerThread = value;
+    else if (name == "memoryBudget")
+    {
+      if (value < 0)
+        throw Exception(Error::InvalidArgument, "invalid memory budget");
+      memoryBudget = size_t(value) * 1024*1024;
+    }
+    else if (name == "memoryPolicy")
+    {
+      if (value < int(MemoryPolicy::Fail) || value > int(MemoryPolicy::Wait))
+        throw Exception(Error::InvalidArgument, "invalid memory policy");
+      memoryPolicy = MemoryPolicy(value);
+    }
+
+    // Explicitly set thread parameters override the autotuned configuration,
+    // which also depends on the kernels
+    if (name == "numThreads" || name == "setAffinity" || name == "numThreadsPerCore" ||
+        name == "builtinKernels" || name == "callerThread")
+      threadConfig.reset();
 
     dirty = true;
   }
@@ -130,24 +189,169 @@ namespace oidn {
     if (isCommitted())
       throw Exception(Error::InvalidOperation, "device can be committed only once");
 
-    // Get the optimal thread affinities
-    if (setAffinity)
+    if (callerThread)
     {
-      affinity = std::make_shared<ThreadAffinity>(1); // one thread per core
-      if (affinity->getNumThreads() == 0)
-        affinity.reset();
+      // Arenas with a single slot (reserved for the calling thread) never
+      // request any worker threads, and the host manages the affinities
+      numThreads = 1;
     }
+    else
+    {
+      // Apply the autotuned thread configuration
+      if (autotune && !threadConfig)
+        autotuneThreads(true);
+
+      if (threadConfig)
+      {
+        numThreads = threadConfig->numThreads;
+        numThreadsPerCore = threadConfig->numThreadsPerCore;
+        setAffinity = threadConfig->setAffinity;
+      }
 
-    // Create the task arena
-    const int maxNumThreads = affinity ? affinity->getNumThreads() : tbb::this_task_arena::max_concurrency();
-    numThreads = (numThreads > 0) ? min(numThreads, maxNumThreads) : maxNumThreads;
-    arena = std::make_shared<tbb::task_arena>(numThreads);
+      // Get the optimal thread affinities
+      if (setAffinity)
+      {
+        affinity = std::make_shared<ThreadAffinity>(numThreadsPerCore > 0 ? numThreadsPerCore : INT_MAX);
+        if (affinity->getNumThreads() == 0)
+          affinity.reset();
+      }
+
+      const int maxNumThreads = affinity ? affinity->getNumThreads() : tbb::this_task_arena::max_concurrency();
+      numThreads = (numThreads > 0) ? min(numThreads, maxNumThreads) : maxNumThreads;
+    }
+
+    // Create the task arena for the default priority
+
+    // Count hardware events in the threads executing the filters
+    if (verbose >= 2)
+      perfCounters = std::make_shared<PerfCounters>();
+
+    // Reserve a quarter of the threads for the memory-bound stages of
+    // pipelined execution, which are pinned to the last cores, so they do not
+    // compete with the network stage (which runs on the remaining threads)
+    numIOThreads = (numThreads >= 2) ? max(numThreads / 4, 1) : 0;
+    if (numIOThreads > 0)
+      ioArena = makeArena(numIOThreads, numThreads - numIOThreads);
+
+    arena = getArena(0);
+
+    dirty = false;
+
+    if (verbose >= 1)
+    {
+      std::cout << "  Version: " << OIDN_VERSION_MAJOR << "." << OIDN_VERSION_MINOR << "." << OIDN_VERSION_PATCH << std::endl;
+      std::cout << "  ISA    : " << (mayiuse(avx512_common) ? "AVX-512" : (mayiuse(avx2) ? "AVX2" : "SSE4.1")) << std::endl;
+      std::cout << "  Kernels: " << (useBuiltinKernels() ? "built-in" : "MKL-DNN") << std::endl;
+      std::cout << "  Threads: " << numThreads << " (" << (callerThread ? "caller thread" : (affinity ? "affinitized" : "non-affinitized")) << ")" << std::endl;
+    }
+  }
+
+  void Device::autotuneThreads(bool useCache)
+  {
+    if (isCommitted())
+      throw Exception(Error::InvalidOperation, "device can be autotuned only before committing");
+
+    // All work is executed on a single thread
+    if (callerThread)
+      return;
+
+    const int maxNumThreads = max(numThreads, 0);
+    const std::string fingerprint = getMachineFingerprint(maxNumThreads, useBuiltinKernels());
+
+    ThreadConfig config;
+    if (useCache && loadThreadConfig(fingerprint, config))
+    {
+      if (verbose >= 1)
+        std::cout << "  Autotune: cached " << config << std::endl;
+    }
+    else
+    {
+      config = tuneThreadConfig(maxNumThreads, useBuiltinKernels(), verbose);
+      if (!saveThreadConfig(fingerprint, config) && verbose >= 1)
+        OIDN_WARNING("could not write the autotuning cache file");
+    }
+
+    threadConfig = std::make_shared<ThreadConfig>(config);
+    dirty = true;
+  }
+
+  std::shared_ptr<tbb::task_arena> Device::getArena(int priority)
+  {
+    // Each priority has its own arena, so a suspended lower priority execution
+    // does not occupy any slots in the arena of a higher priority execution
+    auto& priorityArena = arenas[priority];
+    if (!priorityArena)
+    {
+      priorityArena = makeArena(numThreads);
+      if (numIOThreads > 0)
+        pipelineArenas[priority] = makeArena(numThreads - numIOThreads);
+    }
+    return priorityArena;
+  }
+
+  std::shared_ptr<tbb::task_arena> Device::makeArena(int numArenaThreads, int threadIndexOffset)
+  {
+    auto newArena = std::make_shared<tbb::task_arena>(numArenaThreads);
 
     // Automatically set the thread affinities
     if (affinity)
-      observer = std::make_shared<PinningObserver>(affinity, *arena);
+      observers.push_back(std::make_shared<PinningObserver>(affinity, *newArena, threadIndexOffset));
 
-    dirty = false;
+    if (perfCounters)
+      observers.push_back(std::make_shared<PerfCounterObserver>(perfCounters, *newArena));
+
+    return newArena;
+  }
+
+  void Device::waitForExecution(std::unique_lock<std::mutex>& lock, int priority)
+  {
+    waitingPriorities.insert(priority);
+    executionCond.wait(lock, [&]() { return !executing && priority >= *waitingPriorities.rbegin(); });
+    waitingPriorities.erase(waitingPriorities.find(priority));
+
+    executing = true;
+    executionPriority = priority;
+    arena = arenas[priority];
+    pipelineArena = (numIOThreads > 0) ? pipelineArenas[priority] : nullptr;
+  }
+
+  void Device::beginExecution(int priority)
+  {
+    checkCommitted();
+
+    std::unique_lock<std::mutex> lock(mutex, std::adopt_lock);
+    try
+    {
+      getArena(priority);
+      waitForExecution(lock, priority);
+    }
+    catch (...)
+    {
+      lock.release(); // keep the mutex locked for the caller
+      throw;
+    }
+  }
+
+  void Device::endExecution()
+  {
+    mutex.lock();
+    executing = false;
+    executionCond.notify_all();
+    memoryCond.notify_all(); // the filter can be trimmed now
+  }
+
+  void Device::yieldExecution()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    assert(executing);
+
+    if (waitingPriorities.empty() || *waitingPriorities.rbegin() <= executionPriority)
+      return;
+
+    // Let the higher priority executions run, then resume
+    executing = false;
+    executionCond.notify_all();
+    waitForExecution(lock, executionPriority);
   }
 
   void Device::checkCommitted()
@@ -168,6 +372,219 @@ namespace oidn {
     return makeRef<Buffer>(Ref<Device>(this), ptr, byteSize);
   }
 
+  Ref<Buffer> Device::newImageBuffer(Format format, int width, int height, size_t& bytePixelStride, size_t& byteRowStride)
+  {
+    checkCommitted();
+
+    if (format == Format::Undefined)
+      throw Exception(Error::InvalidArgument, "invalid image format");
+    if (width < 0 || height < 0 || width > Image::maxSize || height > Image::maxSize)
+      throw Exception(Error::InvalidArgument, "invalid image size");
+
+    // Pad the rows, so the images can be processed in aligned blocks of
+    // pixels without handling the edges
+    bytePixelStride = getFormatBytes(format);
+    byteRowStride = getPaddedImageByteRowStride(format, width);
+    return makeRef<Buffer>(Ref<Device>(this), byteRowStride * height, byteRowStride);
+  }
+
+  const Throughput& Device::getThroughput()
+  {
+    if (!throughput)
+      throughput = std::make_shared<Throughput>(measureThroughput(this));
+    return *throughput;
+  }
+
+  void Device::trim()
+  {
+    checkCommitted();
+
+    for (const auto& item : filters)
+    {
+      if (!item.first->isExecuting())
+        item.first->trim();
+    }
+  }
+
+  std::chrono::steady_clock::time_point Device::trimIdleFilters()
+  {
+    const auto now = std::chrono::steady_clock::now();
+    auto next = std::chrono::steady_clock::time_point::max();
+
+    for (const auto& item : filters)
+    {
+      Filter* filter = item.first;
+      std::chrono::steady_clock::time_point time;
+      if (!filter->getIdleTrimTime(time))
+        continue;
+
+      if (time <= now)
+        filter->trim();
+      else
+        next = min(next, time);
+    }
+
+    return next;
+  }
+
+  void Device::scheduleTrim()
+  {
+    // Without a background thread, the idle filters are trimmed only when an
+    // execution finishes
+    if (callerThread)
+    {
+      trimIdleFilters();
+      return;
+    }
+
+    if (!trimThread.joinable())
+    {
+      bool pending = false;
+      std::chrono::steady_clock::time_point time;
+      for (const auto& item : filters)
+        pending |= item.first->getIdleTrimTime(time);
+      if (!pending)
+        return;
+
+      trimThread = std::thread([this]() { trimLoop(); });
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(trimMutex);
+      trimScheduled = true;
+    }
+    trimCond.notify_all();
+  }
+
+  void Device::trimLoop()
+  {
+    // Retry interval if the device mutex is locked by another thread
+    const auto retryDelay = std::chrono::milliseconds(1);
+
+    std::unique_lock<std::mutex> trimLock(trimMutex);
+    auto next = std::chrono::steady_clock::time_point::min(); // trim immediately
+
+    while (!trimExit)
+    {
+      if (trimScheduled || std::chrono::steady_clock::now() >= next)
+      {
+        trimScheduled = false;
+        trimLock.unlock();
+
+        {
+          std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+          if (lock.owns_lock())
+            next = trimIdleFilters();
+          else
+            next = std::chrono::steady_clock::now() + retryDelay;
+        }
+
+        trimLock.lock();
+        continue;
+      }
+
+      const auto wakeup = [&]() { return trimExit || trimScheduled; };
+      if (next == std::chrono::steady_clock::time_point::max())
+        trimCond.wait(trimLock, wakeup);
+      else
+        trimCond.wait_until(trimLock, next, wakeup);
+    }
+  }
+
+  void Device::registerFilter(Filter* filter)
+  {
+    filters[filter] = 0;
+  }
+
+  void Device::unregisterFilter(Filter* filter)
+  {
+    setMemoryUsage(filter, 0);
+    filters.erase(filter);
+  }
+
+  void Device::setMemoryUsage(Filter* filter, size_t byteSize)
+  {
+    size_t& filterByteSize = filters.at(filter);
+    memoryUsage = memoryUsage - filterByteSize + byteSize;
+    if (byteSize < filterByteSize)
+      memoryCond.notify_all();
+    filterByteSize = byteSize;
+  }
+
+  bool Device::fitsMemory(Filter* filter, size_t byteSize) const
+  {
+    return memoryUsage - filters.at(filter) + byteSize <= memoryBudget;
+  }
+
+  void Device::trimForMemory(Filter* filter, size_t byteSize)
+  {
+    // Collect the other filters which can be trimmed
+    std::vector<Filter*> idleFilters;
+    for (const auto& item : filters)
+    {
+      if (item.first != filter && item.second > 0 && item.first->isTrimmable())
+        idleFilters.push_back(item.first);
+    }
+
+    std::sort(idleFilters.begin(), idleFilters.end(), [](Filter* a, Filter* b)
+    {
+      return a->getLastExecutionTime() < b->getLastExecutionTime();
+    });
+
+    for (Filter* idleFilter : idleFilters)
+    {
+      if (fitsMemory(filter, byteSize))
+        break;
+      idleFilter->trim();
+    }
+  }
+
+  void Device::reserveMemory(Filter* filter, size_t byteSize)
+  {
+    if (memoryBudget == 0 || byteSize <= filters.at(filter))
+    {
+      setMemoryUsage(filter, byteSize);
+      return;
+    }
+
+    if (byteSize > memoryBudget)
+      throw Exception(Error::OutOfMemory, "the filter requires more memory than the memory budget of the device");
+
+    if (memoryPolicy != MemoryPolicy::Fail)
+      trimForMemory(filter, byteSize);
+
+    if (!fitsMemory(filter, byteSize) && memoryPolicy == MemoryPolicy::Wait)
+    {
+      // Wait until other filters release memory or finish executing, then try
+      // trimming them again
+      // While waiting, the filter itself can be trimmed by the other waiting
+      // filters, otherwise these could wait for each other forever.
+      std::unique_lock<std::mutex> lock(mutex, std::adopt_lock);
+      filter->waitingForMemory = true;
+      try
+      {
+        memoryCond.wait(lock, [&]()
+        {
+          trimForMemory(filter, byteSize);
+          return fitsMemory(filter, byteSize);
+        });
+      }
+      catch (...)
+      {
+        filter->waitingForMemory = false;
+        lock.release(); // keep the mutex locked for the caller
+        throw;
+      }
+      filter->waitingForMemory = false;
+      lock.release();
+    }
+
+    if (!fitsMemory(filter, byteSize))
+      throw Exception(Error::OutOfMemory, "memory budget of the device exceeded");
+
+    setMemoryUsage(filter, byteSize);
+  }
+
   Ref<Filter> Device::newFilter(const std::string& type)
   {
     checkCommitted();
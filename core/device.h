@@ -17,11 +17,18 @@
 #pragma once
 
 #include "common.h"
+#include "common/perf_counters.h"
+#include <condition_variable>
+#include <thread>
+#include <map>
+#include <set>
 
 namespace oidn {
 
   class Buffer;
   class Filter;
+  struct Throughput;
+  struct ThreadConfig;
 
   class Device : public RefCount
   {
@@ -42,13 +49,63 @@ namespace oidn {
     void* errorUserPtr = nullptr;
 
     // Tasking
-    std::shared_ptr<tbb::task_arena> arena;
-    std::shared_ptr<PinningObserver> observer;
+    std::shared_ptr<tbb::task_arena> arena;   // arena of the current execution
+    std::map<int, std::shared_ptr<tbb::task_arena>> arenas; // one arena per priority
+
+    // Pipelined execution runs the I/O stages concurrently with the network,
+    // so the threads are split between two arenas pinned to disjoint cores
+    int numIOThreads = 0; // threads reserved for the I/O stages (0 if not pipelined)
+    std::shared_ptr<tbb::task_arena> pipelineArena; // network stage of the current execution
+    std::map<int, std::shared_ptr<tbb::task_arena>> pipelineArenas; // one arena per priority
+    std::shared_ptr<tbb::task_arena> ioArena; // I/O stages (shared by all priorities)
+    std::vector<std::shared_ptr<tbb::task_scheduler_observer>> observers;
     std::shared_ptr<ThreadAffinity> affinity;
 
+    // Scheduling of executions (only one can run at a time)
+    std::condition_variable executionCond;
+    std::multiset<int> waitingPriorities; // priorities of the executions waiting to run
+    bool executing = false;
+    int executionPriority = 0;
+
+    // Registered filters and the memory reserved by them
+    std::map<Filter*, size_t> filters;
+
+    // Memory budget shared by the filters (admission control)
+    size_t memoryBudget = 0; // in bytes (unlimited if 0)
+    MemoryPolicy memoryPolicy = MemoryPolicy::Trim;
+    size_t memoryUsage = 0;  // total memory reserved by the filters
+    std::condition_variable memoryCond;
+
+    // Trimming the memory of idle filters (in a background thread, started
+    // when the first filter with an idle timeout is executed)
+    // The thread has its own mutex, and it only tries to lock the device
+    // mutex, because the device may be destroyed by a thread which holds the
+    // device mutex (when releasing the last filter referencing the device).
+    std::thread trimThread;
+    std::mutex trimMutex;
+    std::condition_variable trimCond;
+    bool trimScheduled = false; // protected by trimMutex
+    bool trimExit = false;      // protected by trimMutex
+
+    // Profiling
+    std::shared_ptr<PerfCounters> perfCounters;
+    std::shared_ptr<Throughput> throughput; // measured on first use
+
+    // Autotuned thread configuration (overrides the thread parameters when committing)
+    std::shared_ptr<ThreadConfig> threadConfig;
+
     // Parameters
     int numThreads = 0; // autodetect by default
     bool setAffinity = true;
+    int numThreadsPerCore = 1; // threads pinned to each core if setAffinity is enabled (all hardware threads if 0)
+    bool autotune = false;     // autotune the thread configuration when committing (cached per machine)
+    int verbose = 0;    // 1: print device info, 2: also print profiling report after each execution
+    bool callerThread = false; // execute everything on the calling thread without creating threads
+#if defined(OIDN_BUILTIN_KERNELS)
+    bool builtinKernels = true;
+#else
+    bool builtinKernels = false;
+#endif
 
     bool dirty = true;
 
@@ -66,6 +123,12 @@ namespace oidn {
 
     void commit();
 
+    // Selects the fastest thread configuration by timing a synthetic network
+    // with the candidate configurations, and stores it in the cache file
+    // If useCache is true, the cached configuration of the machine is used if
+    // available. Must be called before committing.
+    void autotuneThreads(bool useCache = false);
+
     template<typename F>
     void executeTask(F& f)
     {
@@ -78,16 +141,107 @@ namespace oidn {
       arena->execute(f);
     }
 
+    // Executes the network stage of pipelined execution (requires I/O threads)
+    template<typename F>
+    void executePipelineTask(const F& f)
+    {
+      pipelineArena->execute(f);
+    }
+
+    // Executes an I/O stage of pipelined execution (requires I/O threads)
+    template<typename F>
+    void executeIOTask(const F& f)
+    {
+      ioArena->execute(f);
+    }
+
+    // Begins an execution with the specified priority, waiting until all
+    // other executions with the same or higher priority have finished
+    // The device mutex must be locked by the caller, and it is unlocked while
+    // executing, thus other API calls can proceed in the meantime.
+    void beginExecution(int priority);
+
+    // Ends the current execution, locking the device mutex again
+    void endExecution();
+
+    // Suspends the current execution while there are higher priority
+    // executions waiting to run (must be called outside of the device mutex)
+    void yieldExecution();
+
     Ref<Buffer> newBuffer(size_t byteSize);
     Ref<Buffer> newBuffer(void* ptr, size_t byteSize);
+    Ref<Buffer> newImageBuffer(Format format, int width, int height, size_t& bytePixelStride, size_t& byteRowStride);
     Ref<Filter> newFilter(const std::string& type);
 
+    // Releases the memory of all filters which are not executing
+    // The device mutex must be locked by the caller.
+    void trim();
+
+    // Registers a filter for trimming and memory accounting
+    // The device mutex must be locked by the caller.
+    void registerFilter(Filter* filter);
+    void unregisterFilter(Filter* filter);
+
+    // Reserves memory for a filter, replacing its previous reservation
+    // If the budget would be exceeded, the other filters may be trimmed, or
+    // the call may wait until memory is released, depending on the policy.
+    // Filters waiting for memory can be trimmed by the other filters.
+    // The device mutex must be locked by the caller, but it may be unlocked
+    // while waiting.
+    void reserveMemory(Filter* filter, size_t byteSize);
+
+    // Sets the memory used by a filter without checking the budget
+    // The device mutex must be locked by the caller.
+    void setMemoryUsage(Filter* filter, size_t byteSize);
+
+    // Schedules trimming the filters which have become idle
+    // The device mutex must be locked by the caller.
+    void scheduleTrim();
+
+    int getVerbose() const { return verbose; }
+
+    // Returns the memory budget in bytes (0 if unlimited)
+    size_t getMemoryBudget() const { return memoryBudget; }
+
+    // Returns whether the built-in kernels should be used instead of MKL-DNN
+    // for the convolutions and poolings
+    bool useBuiltinKernels() const { return (builtinKernels || callerThread) && mayiuse(avx2); }
+
+    // Returns the measured compute and memory throughput
+    // Must be called within an execution, and it is measured the first time.
+    const Throughput& getThroughput();
+
+    // Returns the number of threads used for executions (after committing)
+    int getNumThreads() const { return numThreads; }
+    int getNumIOThreads() const { return numIOThreads; }
+
+    // Returns whether all work is executed on the thread calling the API functions
+    bool isCallerThread() const { return callerThread; }
+
+    // Returns the performance counters of the threads executing filters if
+    // profiling is enabled, otherwise null
+    const std::shared_ptr<PerfCounters>& getPerfCounters() const { return perfCounters; }
+
     Device* getDevice() { return this; }
     std::mutex& getMutex() { return mutex; }
 
   private:
     bool isCommitted() const { return bool(arena); }
     void checkCommitted();
+
+    std::shared_ptr<tbb::task_arena> getArena(int priority);
+    std::shared_ptr<tbb::task_arena> makeArena(int numArenaThreads, int threadIndexOffset = 0);
+    void waitForExecution(std::unique_lock<std::mutex>& lock, int priority);
+
+    // Trims the filters whose idle timeout has expired, and returns the time
+    // when the next filter will expire (the maximum time if none)
+    std::chrono::steady_clock::time_point trimIdleFilters();
+    void trimLoop();
+
+    // Trims the least recently executed filters which are not executing until
+    // the specified amount of memory fits into the budget
+    void trimForMemory(Filter* filter, size_t byteSize);
+    bool fitsMemory(Filter* filter, size_t byteSize) const;
   };
 
 } // namespace oidn
@@ -0,0 +1,186 @@
+// ======================================================================== //
+// Copyright 2009-2019 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "node.h"
+#include "kernels.h"
+
+namespace oidn {
+
+  // 3x3 direct convolution node using the built-in kernels (AVX2 or AVX-512)
+  // Supports the nChw8c (AVX2) and nChw16c (AVX-512) formats
+  template<int K>
+  class DirectConvNode : public Node
+  {
+    static_assert(K == 8 || K == 16, "unsupported block size");
+
+  private:
+    std::shared_ptr<memory> src;
+    std::shared_ptr<memory> bias;
+    std::shared_ptr<memory> dst;
+    std::shared_ptr<memory> poolDst; // destination of the fused pooling (optional)
+    std::shared_ptr<float> weights;  // reordered weights
+    double workAmount;
+    bool relu;
+
+  public:
+    DirectConvNode(const std::shared_ptr<memory>& src,
+                   const std::shared_ptr<memory>& weightsPad,
+                   const std::shared_ptr<memory>& bias,
+                   const std::shared_ptr<memory>& dst,
+                   bool relu)
+      : src(src),
+        bias(bias),
+        dst(dst),
+        relu(relu)
+    {
+      memory::primitive_desc weightsPrimDesc = weightsPad->get_primitive_desc();
+      const mkldnn_memory_desc_t& weightsDesc = weightsPrimDesc.desc().data;
+      assert(weightsDesc.format == memory::format::oihw);
+      assert(weightsDesc.dims[2] == 3 && weightsDesc.dims[3] == 3);
+      assert(getTensorDims(src)[1] == weightsDesc.dims[1]); // IC
+      assert(getTensorDims(dst)[1] == weightsDesc.dims[0]); // OC
+      assert(getTensorDims(src)[2] == getTensorDims(dst)[2]); // H
+      assert(getTensorDims(src)[3] == getTensorDims(dst)[3]); // W
+
+      // Reorder the weights from oihw to [OC/K][IC/K][3][3][K ic][K oc]
+      const int OC = weightsDesc.dims[0];
+      const int IC = weightsDesc.dims[1];
+      const int ICB = IC / K;
+      const float* srcWeights = (const float*)weightsPad->get_data_handle();
+      weights = std::shared_ptr<float>((float*)alignedMalloc(size_t(OC) * IC * 9 * sizeof(float), 64), alignedFree);
+      float* dstWeights = weights.get();
+
+      parallel_nd(OC / K, ICB, [&](int ocb, int icb)
+      {
+        for (int k = 0; k < 9; ++k)
+        {
+          for (int ic = 0; ic < K; ++ic)
+          {
+            for (int oc = 0; oc < K; ++oc)
+            {
+              dstWeights[(((size_t(ocb) * ICB + icb) * 9 + k) * K + ic) * K + oc] =
+                srcWeights[((size_t(ocb) * K + oc) * IC + icb * K + ic) * 9 + k];
+            }
+          }
+        }
+      });
+
+      workAmount = getConvWorkAmount(weightsPad, dst);
+    }
+
+    // Creates a convolution with the same weights but different tensors
+    // (the fused pooling is not shared)
+    DirectConvNode(const DirectConvNode& other,
+                   const std::shared_ptr<memory>& src,
+                   const std::shared_ptr<memory>& dst)
+      : src(src),
+        bias(other.bias),
+        dst(dst),
+        weights(other.weights),
+        workAmount(getConv3x3WorkAmount(src, dst)), // the spatial size may differ
+        relu(other.relu)
+    {
+      assert(getTensorDims(src)[1] == getTensorDims(other.src)[1]); // IC
+      assert(getTensorDims(dst)[1] == getTensorDims(other.dst)[1]); // OC
+      assert(getTensorDims(src)[2] == getTensorDims(dst)[2]); // H
+      assert(getTensorDims(src)[3] == getTensorDims(dst)[3]); // W
+    }
+
+    void execute() override
+    {
+      const memory::dims srcDims = getTensorDims(src);
+      const memory::dims dstDims = getTensorDims(dst);
+
+      ConvKernelParams p;
+      p.src     = (const float*)src->get_data_handle();
+      p.weights = weights.get();
+      p.bias    = (const float*)bias->get_data_handle();
+      p.dst     = (float*)dst->get_data_handle();
+      p.IC      = srcDims[1];
+      p.OC      = dstDims[1];
+      p.H       = srcDims[2];
+      p.W       = srcDims[3];
+      p.relu    = relu;
+
+      if (poolDst)
+      {
+        executeFusedPool(p);
+        return;
+      }
+
+      parallel_nd(p.OC / K, p.H, [&](int ocb, int h)
+      {
+        executeConvRow(p, ocb, h);
+      });
+    }
+
+    // Fuses a 2x2 max pooling of the destination into the convolution, which
+    // is then computed right after each pair of destination rows while they
+    // are still in cache (the pooling node must not be executed)
+    void fusePool(const std::shared_ptr<memory>& poolDst)
+    {
+      assert(getTensorDims(poolDst)[1] == getTensorDims(dst)[1]);
+      this->poolDst = poolDst;
+    }
+
+    std::shared_ptr<memory> getDst() const override { return dst; }
+    double getWorkAmount() const override { return workAmount; }
+
+  private:
+    static void executeConvRow(const ConvKernelParams& p, int ocb, int h)
+    {
+      if (K == 16)
+        executeConvKernel_avx512(p, ocb, h);
+      else
+        executeConvKernel_avx2(p, ocb, h);
+    }
+
+    void executeFusedPool(const ConvKernelParams& p)
+    {
+      const memory::dims poolDstDims = getTensorDims(poolDst);
+
+      PoolKernelParams pp;
+      pp.src = p.dst;
+      pp.dst = (float*)poolDst->get_data_handle();
+      pp.C   = p.OC;
+      pp.H   = p.H;
+      pp.W   = p.W;
+      pp.OH  = poolDstDims[2];
+      pp.OW  = poolDstDims[3];
+
+      // Only the blocks of channels are independent
+      parallel_nd(p.OC / K, [&](int ocb)
+      {
+        for (int h = 0; h < p.H; ++h)
+        {
+          executeConvRow(p, ocb, h);
+
+          // Pool the last two rows (or the last row for odd heights)
+          if (h % 2 == 1 || h == p.H-1)
+          {
+            if (K == 16)
+              executePoolKernel_avx512(pp, ocb, h / 2);
+            else
+              executePoolKernel_avx2(pp, ocb, h / 2);
+          }
+        }
+      });
+    }
+  };
+
+} // namespace oidn
@@ -19,24 +19,179 @@
 #include "common.h"
 #include "device.h"
 #include "image.h"
+#include <chrono>
 
 namespace oidn {
 
   class Filter : public RefCount
   {
+    friend class Device;
+
   protected:
     Ref<Device> device;
 
+    ProgressMonitorFunction progressFunc = nullptr;
+    void* progressUserPtr = nullptr;
+
+    int priority = 0;       // higher priority executions preempt lower priority ones
+    bool executing = false; // the filter cannot be modified while executing
+    bool waitingForMemory = false; // executing, but still waiting for its memory reservation (set by the device)
+
+    // Trimming the memory when idle
+    float idleTimeout = 0; // seconds after the last execution when the filter is trimmed (never if 0)
+    bool trimPending = false;
+    std::chrono::steady_clock::time_point lastExecutionTime; // also used for trimming the least recently executed filters
+
   public:
-    explicit Filter(const Ref<Device>& device) : device(device) {}
+    explicit Filter(const Ref<Device>& device) : device(device)
+    {
+      // Filters are created with the device mutex locked
+      device->registerFilter(this);
+    }
+
+    ~Filter()
+    {
+      // Filters are destroyed with the device mutex locked
+      device->unregisterFilter(this);
+    }
 
     virtual void setImage(const std::string& name, const Image& data) = 0;
     virtual void set1i(const std::string& name, int value) = 0;
     virtual int get1i(const std::string& name) = 0;
+    virtual void set1f(const std::string& name, float value) = 0;
+    virtual float get1f(const std::string& name) = 0;
+
+    void setProgressMonitorFunction(ProgressMonitorFunction func, void* userPtr)
+    {
+      checkNotExecuting();
+      progressFunc = func;
+      progressUserPtr = userPtr;
+    }
+
+    // Estimates the costs of the layers of an execution with the current
+    // parameters on images with the specified size and features
+    virtual std::vector<LayerCost> estimateCost(int width, int height, bool albedo, bool normal,
+                                                int numThreads, size_t& memoryByteSize) = 0;
+
     virtual void commit() = 0;
     virtual void execute() = 0;
+    virtual void executeSequence(const Frame* frames, size_t numFrames) = 0;
+
+    // Returns an internal tensor of the committed filter
+    virtual void* getTensor(const std::string& name, TensorDesc& desc) = 0;
 
     Device* getDevice() { return device.get(); }
+
+    bool isExecuting() const { return executing; }
+
+    // Returns whether the filter can be trimmed to make room for another one:
+    // it must not be executing, or it must still be waiting for memory (its
+    // buffers are not in use yet, and two waiting filters must not block each
+    // other forever)
+    bool isTrimmable() const { return !executing || waitingForMemory; }
+
+    // Releases the memory which is re-allocated on the next execution
+    // The device mutex must be locked, and the filter must be trimmable.
+    void trim()
+    {
+      assert(isTrimmable());
+      trimPending = false;
+      trimMemory();
+      device->setMemoryUsage(this, getMemoryByteSize(true));
+    }
+
+    std::chrono::steady_clock::time_point getLastExecutionTime() const { return lastExecutionTime; }
+
+    // Returns whether the filter will become idle, and the time when it will
+    // have to be trimmed
+    bool getIdleTrimTime(std::chrono::steady_clock::time_point& time) const
+    {
+      if (!trimPending || executing)
+        return false;
+      time = lastExecutionTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                   std::chrono::duration<float>(idleTimeout));
+      return true;
+    }
+
+  protected:
+    virtual void trimMemory() = 0;
+
+    // Returns the size of the memory allocated by the filter which is
+    // accounted in the memory budget of the device, excluding the trimmed
+    // memory if residentOnly is true
+    virtual size_t getMemoryByteSize(bool residentOnly) const = 0;
+
+    void setIdleTimeout(float value)
+    {
+      if (!(value >= 0.f && isfinite(value)))
+        throw Exception(Error::InvalidArgument, "invalid idle timeout");
+      idleTimeout = value;
+      startIdleTime();
+    }
+
+    // Starts the idle time of the filter after it was used
+    void startIdleTime()
+    {
+      lastExecutionTime = std::chrono::steady_clock::now();
+      trimPending = idleTimeout > 0.f;
+      device->scheduleTrim();
+    }
+
+    void checkNotExecuting()
+    {
+      if (executing)
+        throw Exception(Error::InvalidOperation, "the filter cannot be modified while executing");
+    }
+
+    // Executes a function exclusively on the device with the priority of the filter
+    // The specified amount of memory is reserved before the execution, and
+    // the reservation is updated with the actually allocated memory afterwards.
+    // The device mutex must be locked by the caller, but it is unlocked during
+    // the execution.
+    template<typename F>
+    void executeExclusive(const F& f, size_t memoryByteSize = 0)
+    {
+      if (executing)
+        throw Exception(Error::InvalidOperation, "the filter is already executing");
+      executing = true; // the filter cannot be trimmed while executing
+
+      try
+      {
+        if (memoryByteSize > 0)
+          device->reserveMemory(this, memoryByteSize);
+        device->beginExecution(priority);
+      }
+      catch (...)
+      {
+        executing = false;
+        device->setMemoryUsage(this, getMemoryByteSize(true));
+        throw;
+      }
+
+      try
+      {
+        f();
+      }
+      catch (...)
+      {
+        device->endExecution();
+        executing = false;
+        finishExecution();
+        throw;
+      }
+
+      device->endExecution();
+      executing = false;
+      finishExecution();
+    }
+
+  private:
+    // Updates the memory usage, and starts the idle time of the filter
+    void finishExecution()
+    {
+      device->setMemoryUsage(this, getMemoryByteSize(true));
+      startIdleTime();
+    }
   };
 
 } // namespace oidn
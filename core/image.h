@@ -21,6 +21,18 @@
 
 namespace oidn {
 
+  // The rows of the images in image buffers allocated by the device are padded
+  // to a multiple of this many pixels, and aligned to the cache line size
+  constexpr int imageRowPadding = 16;
+  constexpr size_t imageAlignment = 64;
+
+  // Returns the row stride of the images with padded rows
+  inline size_t getPaddedImageByteRowStride(Format format, int width)
+  {
+    const size_t byteRowStride = size_t((width + imageRowPadding - 1) / imageRowPadding * imageRowPadding) * getFormatBytes(format);
+    return (byteRowStride + imageAlignment - 1) / imageAlignment * imageAlignment;
+  }
+
   struct Image
   {
     static constexpr int maxSize = 65536;
@@ -29,11 +41,12 @@ namespace oidn {
     int width;              // width in number of pixels
     int height;             // height in number of pixels
     size_t bytePixelStride; // pixel stride in number of *bytes*
-    size_t rowStride;       // row stride in number of *pixel strides*
+    size_t byteRowStride;   // row stride in number of *bytes*
     Format format;          // pixel format
     Ref<Buffer> buffer;     // buffer containing the image data
+    bool padded;            // rows are aligned, and padded to a multiple of imageRowPadding pixels which may be overwritten
 
-    Image() : ptr(nullptr), width(0), height(0), bytePixelStride(0), rowStride(0), format(Format::Undefined) {}
+    Image() : ptr(nullptr), width(0), height(0), bytePixelStride(0), byteRowStride(0), format(Format::Undefined), padded(false) {}
 
     Image(void* ptr, Format format, int width, int height, size_t byteOffset, size_t inBytePixelStride, size_t inByteRowStride)
     {
@@ -45,14 +58,30 @@ namespace oidn {
 
     Image(const Ref<Buffer>& buffer, Format format, int width, int height, size_t byteOffset, size_t inBytePixelStride, size_t inByteRowStride)
     {
+      // Use the row stride of image buffers by default
+      const size_t imageByteRowStride = buffer->getImageByteRowStride();
+      if (inByteRowStride == 0 && (inBytePixelStride == 0 || inBytePixelStride == getFormatBytes(format)))
+        inByteRowStride = imageByteRowStride;
+
       init(buffer->data() + byteOffset, format, width, height, inBytePixelStride, inByteRowStride);
 
-      if (byteOffset + height * rowStride * bytePixelStride > buffer->size())
+      if (byteOffset + height * byteRowStride > buffer->size())
         throw Exception(Error::InvalidArgument, "buffer region out of range");
+
+      // Check whether the image is stored with padded rows, starting at a row
+      // of an image buffer
+      padded = imageByteRowStride != 0 &&
+               byteRowStride == imageByteRowStride &&
+               bytePixelStride == getFormatBytes(format) &&
+               byteOffset % imageByteRowStride == 0 &&
+               getPaddedImageByteRowStride(format, width) <= imageByteRowStride;
+      this->buffer = buffer;
     }
 
     void init(char* ptr, Format format, int width, int height, size_t inBytePixelStride, size_t inByteRowStride)
     {
+      padded = false;
+
       assert(width >= 0);
       assert(height >= 0);
       if (width > maxSize || height > maxSize)
@@ -75,18 +104,18 @@ namespace oidn {
         this->bytePixelStride = pixelSize;
       }
 
+      // The row stride does not have to be a multiple of the pixel stride
+      // (e.g. for strided views of arrays with padded rows)
       if (inByteRowStride != 0)
       {
         if (inByteRowStride < width * this->bytePixelStride)
           throw Exception(Error::InvalidArgument, "row stride smaller than width * pixel stride");
-        if (inByteRowStride % this->bytePixelStride != 0)
-          throw Exception(Error::InvalidArgument, "row stride not integer multiple of pixel stride");
 
-        this->rowStride = inByteRowStride / this->bytePixelStride;
+        this->byteRowStride = inByteRowStride;
       }
       else
       {
-        this->rowStride = width;
+        this->byteRowStride = width * this->bytePixelStride;
       }
 
       this->format = format;
@@ -94,12 +123,12 @@ namespace oidn {
 
     __forceinline char* get(int y, int x)
     {
-      return ptr + ((size_t(y) * rowStride + size_t(x)) * bytePixelStride);
+      return ptr + size_t(y) * byteRowStride + size_t(x) * bytePixelStride;
     }
 
     __forceinline const char* get(int y, int x) const
     {
-      return ptr + ((size_t(y) * rowStride + size_t(x)) * bytePixelStride);
+      return ptr + size_t(y) * byteRowStride + size_t(x) * bytePixelStride;
     }
 
     operator bool() const
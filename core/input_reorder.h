@@ -18,9 +18,34 @@
 
 #include "node.h"
 #include "image.h"
+#include "tone_mapping.h"
 
 namespace oidn {
 
+  // Statistics of the input images computed while reordering them
+  struct InputStats
+  {
+    float exposure = 1.f;       // automatic exposure of the color (1 if not estimated)
+    int numNonFinitePixels = 0; // pixels with NaN or Inf values in any of the images
+    int numNegativePixels = 0;  // color pixels with negative values
+  };
+
+  // Interface for analyzing the input images in the same pass as the reorder
+  class InputAnalyzer
+  {
+  public:
+    virtual ~InputAnalyzer() = default;
+
+    // Called before the reorder with the transfer function to use
+    // Returns the row sampling stride for estimating the exposure, or 0 if the
+    // transfer function does not depend on the analysis (then it is applied
+    // while reordering, otherwise afterwards in place)
+    virtual int prepareInput(TransferFunc& transferFunc) = 0;
+
+    // Called with the statistics before the deferred transfer function is applied
+    virtual void analyzeInput(const InputStats& stats, TransferFunc& transferFunc) = 0;
+  };
+
   // Input reorder node
   template<int K, class TransferFunc>
   class InputReorderNode : public Node
@@ -37,16 +62,30 @@ namespace oidn {
     int W2;
 
     std::shared_ptr<TransferFunc> transferFunc;
+    InputAnalyzer* analyzer;
+
+    // Statistics of a block of rows
+    struct RowStats
+    {
+      float logLuminanceSum = 0.f; // sum of the log2 luminances of the autoexposure blocks
+      int numBlocks = 0;           // number of autoexposure blocks with non-zero luminance
+      int numNonFinitePixels = 0;
+      int numNegativePixels = 0;
+    };
+
+    std::vector<RowStats> rowStats;
 
   public:
     InputReorderNode(const Image& color,
                      const Image& albedo,
                      const Image& normal,
                      const std::shared_ptr<memory>& dst,
-                     const std::shared_ptr<TransferFunc>& transferFunc)
+                     const std::shared_ptr<TransferFunc>& transferFunc,
+                     InputAnalyzer* analyzer = nullptr)
       : color(color), albedo(albedo), normal(normal),
         dst(dst),
-        transferFunc(transferFunc)
+        transferFunc(transferFunc),
+        analyzer(analyzer)
     {
       memory::primitive_desc dstPrimDesc = dst->get_primitive_desc();
       const mkldnn_memory_desc_t& dstDesc = dstPrimDesc.desc().data;
@@ -70,34 +109,163 @@ namespace oidn {
 
     void execute() override
     {
+      // The destination may have been re-allocated
+      dstPtr = (float*)dst->get_data_handle();
+
       const int H1 = color.height;
       const int W1 = color.width;
 
       // Do mirror padding to avoid filtering artifacts near the edges
-      const int H = min(H2, 2*H1-2);
-      const int W = min(W2, 2*W1-2);
+      const int H = min(H2, max(2*H1-2, H1));
+      const int W = min(W2, max(2*W1-2, W1));
+
+      // If the exposure has to be estimated, the transfer function can be
+      // applied only after reading the whole image
+      const int sampleStride = analyzer ? analyzer->prepareInput(*transferFunc) : 0;
+      const bool deferTransfer = sampleStride > 0;
 
-      parallel_nd(H, [&](int h)
+      // Reorder and analyze the image in a single pass, in blocks of rows
+      // matching the autoexposure blocks, or in single rows if there are none
+      const int HK = deferTransfer ? getAutoexposureNumBlocks(H1) : 0;
+      const int WK = deferTransfer ? getAutoexposureNumBlocks(W1) : 0;
+      const bool useBlocks = HK > 0 && WK > 0;
+      const int numRowBlocks = useBlocks ? HK : H1;
+      rowStats.assign(numRowBlocks, RowStats());
+
+      parallel_nd(numRowBlocks, [&](int i)
       {
-        for (int w = 0; w < W; ++w)
+        const int beginH = int(ptrdiff_t(i)   * H1 / numRowBlocks);
+        const int endH   = int(ptrdiff_t(i+1) * H1 / numRowBlocks);
+        RowStats& stats = rowStats[i];
+
+        std::vector<float> blockL(useBlocks ? WK : 0, 0.f); // luminance sums of the blocks
+        int numSampledRows = 0;
+
+        for (int h = beginH; h < endH; ++h)
+        {
+          if (!blockL.empty() && (h - beginH) % sampleStride == 0)
+          {
+            // The luminance is computed from the stored sanitized colors
+            // (the transfer function is deferred)
+            storeRow(h, h, 0, W1, false, stats);
+            const float* dst_h = dstPtr + h*W2*K;
+            for (int j = 0; j < WK; ++j)
+            {
+              const int beginW = int(ptrdiff_t(j)   * W1 / WK);
+              const int endW   = int(ptrdiff_t(j+1) * W1 / WK);
+              blockL[j] += luminanceSum(dst_h + beginW*K, endW - beginW, K);
+            }
+            numSampledRows++;
+          }
+          else
+          {
+            storeRow(h, h, 0, W1, !deferTransfer, stats);
+          }
+
+          // Mirror padding on the right
+          RowStats paddingStats;
+          storeRow(h, h, W1, W, !deferTransfer, paddingStats);
+        }
+
+        // Accumulate the log luminance of the blocks
+        for (int j = 0; j < int(blockL.size()); ++j)
         {
-          // Compute mirror padded coords
-          const int h1 = h < H1 ? h : 2*H1-2-h;
-          const int w1 = w < W1 ? w : 2*W1-2-w;
-
-          int c = 0;
-          storeColor(h, w, c, (float*)color.get(h1, w1));
-          if (albedo)
-            storeAlbedo(h, w, c, (float*)albedo.get(h1, w1));
-          if (normal)
-            storeNormal(h, w, c, (float*)normal.get(h1, w1));
+          const int beginW = int(ptrdiff_t(j)   * W1 / WK);
+          const int endW   = int(ptrdiff_t(j+1) * W1 / WK);
+          const float L = blockL[j] / (numSampledRows * (endW - beginW));
+          if (L > autoexposureEps)
+          {
+            stats.logLuminanceSum += log2(L);
+            stats.numBlocks++;
+          }
         }
       });
+
+      // Mirror padding on the bottom
+      parallel_nd(H - H1, [&](int i)
+      {
+        const int h = H1 + i;
+        RowStats paddingStats;
+        storeRow(h, 2*H1-2-h, 0, W, !deferTransfer, paddingStats);
+      });
+
+      // Reduce the statistics in a fixed order for deterministic results
+      if (analyzer)
+      {
+        InputStats stats;
+        float logLuminanceSum = 0.f;
+        int numBlocks = 0;
+        for (const auto& s : rowStats)
+        {
+          logLuminanceSum += s.logLuminanceSum;
+          numBlocks += s.numBlocks;
+          stats.numNonFinitePixels += s.numNonFinitePixels;
+          stats.numNegativePixels += s.numNegativePixels;
+        }
+        if (deferTransfer)
+          stats.exposure = getAutoexposure(logLuminanceSum, numBlocks);
+
+        analyzer->analyzeInput(stats, *transferFunc);
+      }
+
+      // Apply the transfer function to the color in place
+      if (deferTransfer)
+      {
+        parallel_nd(H, [&](int h)
+        {
+          float* dst_hw = dstPtr + h*W2*K;
+          for (int w = 0; w < W; ++w, dst_hw += K)
+          {
+            #pragma unroll
+            for (int i = 0; i < 3; ++i)
+              dst_hw[i] = transferFunc->forward(dst_hw[i]);
+          }
+        });
+      }
     }
 
     std::shared_ptr<memory> getDst() const override { return dst; }
 
+    // Sets new source images, which must have the same dimensions as the original ones
+    void setSrc(const Image& color, const Image& albedo, const Image& normal)
+    {
+      assert(color.width == this->color.width && color.height == this->color.height);
+      assert(bool(albedo) == bool(this->albedo));
+      assert(bool(normal) == bool(this->normal));
+
+      this->color  = color;
+      this->albedo = albedo;
+      this->normal = normal;
+    }
+
+    void setTransferFunc(const std::shared_ptr<TransferFunc>& transferFunc)
+    {
+      this->transferFunc = transferFunc;
+    }
+
   private:
+    // Stores the pixels [beginW, endW) of a row
+    __forceinline void storeRow(int h, int h1, int beginW, int endW, bool transfer, RowStats& stats)
+    {
+      const int W1 = color.width;
+
+      for (int w = beginW; w < endW; ++w)
+      {
+        // Compute mirror padded coords
+        const int w1 = w < W1 ? w : 2*W1-2-w;
+
+        int c = 0;
+        bool isFinite = true;
+        storeColor(h, w, c, (float*)color.get(h1, w1), transfer, isFinite, stats.numNegativePixels);
+        if (albedo)
+          storeAlbedo(h, w, c, (float*)albedo.get(h1, w1), isFinite);
+        if (normal)
+          storeNormal(h, w, c, (float*)normal.get(h1, w1), isFinite);
+        if (!isFinite)
+          stats.numNonFinitePixels++;
+      }
+    }
+
     // Stores a single value
     __forceinline void store(int h, int w, int& c, float value)
     {
@@ -107,9 +275,12 @@ namespace oidn {
       c++;
     }
 
-    // Stores a color
-    __forceinline void storeColor(int h, int w, int& c, const float* values)
+    // Stores a color, optionally applying the transfer function
+    __forceinline void storeColor(int h, int w, int& c, const float* values, bool transfer,
+                                  bool& isFinite, int& numNegativePixels)
     {
+      bool isNegative = false;
+
       #pragma unroll
       for (int i = 0; i < 3; ++i)
       {
@@ -117,18 +288,31 @@ namespace oidn {
         float x = values[i];
 
         // Sanitize the value
-        x = isfinite(x) ? max(x, 0.f) : 0.f;
+        if (!isfinite(x))
+        {
+          isFinite = false;
+          x = 0.f;
+        }
+        else if (x < 0.f)
+        {
+          isNegative = true;
+          x = 0.f;
+        }
 
         // Apply the transfer function
-        x = transferFunc->forward(x);
+        if (transfer)
+          x = transferFunc->forward(x);
 
         // Store the value
         store(h, w, c, x);
       }
+
+      if (isNegative)
+        numNegativePixels++;
     }
 
     // Stores an albedo
-    __forceinline void storeAlbedo(int h, int w, int& c, const float* values)
+    __forceinline void storeAlbedo(int h, int w, int& c, const float* values, bool& isFinite)
     {
       #pragma unroll
       for (int i = 0; i < 3; ++i)
@@ -137,7 +321,15 @@ namespace oidn {
         float x = values[i];
 
         // Sanitize the value
-        x = isfinite(x) ? clamp(x, 0.f, 1.f) : 0.f;
+        if (isfinite(x))
+        {
+          x = clamp(x, 0.f, 1.f);
+        }
+        else
+        {
+          isFinite = false;
+          x = 0.f;
+        }
 
         // Store the value
         store(h, w, c, x);
@@ -145,7 +337,7 @@ namespace oidn {
     }
 
     // Stores a normal
-    __forceinline void storeNormal(int h, int w, int& c, const float* values)
+    __forceinline void storeNormal(int h, int w, int& c, const float* values, bool& isFinite)
     {
       // Load the normal
       float x = values[0];
@@ -166,6 +358,8 @@ namespace oidn {
       }
       else
       {
+        if (!isfinite(x) || !isfinite(y) || !isfinite(z))
+          isFinite = false;
         x = 0.f;
         y = 0.f;
         z = 0.f;
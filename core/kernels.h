@@ -0,0 +1,64 @@
+// ======================================================================== //
+// Copyright 2009-2019 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include <cstddef>
+
+// This header is included by translation units compiled for different ISAs, so
+// it must not pull in any code which could be shared with other translation
+// units (e.g. inline functions, templates).
+
+namespace oidn {
+
+  // Parameters of a 3x3 convolution with 1x1 zero padding, bias and optional relu
+  // The source and destination tensors are in nChwKc format, and the weights
+  // are in the format produced by the convolution node ([OC/K][IC/K][3][3][K ic][K oc]).
+  struct ConvKernelParams
+  {
+    const float* src;     // source tensor
+    const float* weights; // reordered weights
+    const float* bias;    // biases (OC)
+    float* dst;           // destination tensor
+    int IC;               // number of input channels
+    int OC;               // number of output channels
+    int H;                // height of the source and destination
+    int W;                // width of the source and destination
+    bool relu;            // apply relu after adding the biases
+  };
+
+  // Parameters of a 2x2 max pooling with stride 2 (ceil mode)
+  // The source and destination tensors are in nChwKc format.
+  struct PoolKernelParams
+  {
+    const float* src; // source tensor
+    float* dst;       // destination tensor
+    int C;            // number of channels
+    int H;            // height of the source
+    int W;            // width of the source
+    int OH;           // height of the destination
+    int OW;           // width of the destination
+  };
+
+  // Computes a row of a block of output channels
+  void executeConvKernel_avx2(const ConvKernelParams& p, int ocb, int h);   // nChw8c
+  void executeConvKernel_avx512(const ConvKernelParams& p, int ocb, int h); // nChw16c
+
+  // Computes a row of a block of channels
+  void executePoolKernel_avx2(const PoolKernelParams& p, int cb, int oh);   // nChw8c
+  void executePoolKernel_avx512(const PoolKernelParams& p, int cb, int oh); // nChw16c
+
+} // namespace oidn
@@ -0,0 +1,31 @@
+// ======================================================================== //
+// Copyright 2009-2019 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "kernels_impl.h"
+
+namespace oidn {
+
+  void executeConvKernel_avx2(const ConvKernelParams& p, int ocb, int h)
+  {
+    convRow<8>(p, ocb, h);
+  }
+
+  void executePoolKernel_avx2(const PoolKernelParams& p, int cb, int oh)
+  {
+    poolRow<8>(p, cb, oh);
+  }
+
+} // namespace oidn
@@ -0,0 +1,191 @@
+// ======================================================================== //
+// Copyright 2009-2019 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "kernels.h"
+#include <immintrin.h>
+
+// Templated kernels for the nChwKc formats
+// This header must be included only by the ISA-specific translation units, and
+// everything in it must have internal linkage.
+
+namespace oidn {
+namespace {
+
+  inline int minInt(int a, int b) { return a < b ? a : b; }
+
+  // --------------------------------------------------------------------------
+  // Vector types
+  // --------------------------------------------------------------------------
+
+  template<int K>
+  struct Vec;
+
+#if defined(__AVX2__)
+  template<>
+  struct Vec<8>
+  {
+    using Type = __m256;
+
+    static inline Type zero() { return _mm256_setzero_ps(); }
+    static inline Type load(const float* ptr) { return _mm256_load_ps(ptr); }
+    static inline Type broadcast(const float* ptr) { return _mm256_broadcast_ss(ptr); }
+    static inline Type fmadd(Type a, Type b, Type c) { return _mm256_fmadd_ps(a, b, c); }
+    static inline Type max(Type a, Type b) { return _mm256_max_ps(a, b); }
+    static inline void store(float* ptr, Type a) { _mm256_store_ps(ptr, a); }
+  };
+#endif
+
+#if defined(__AVX512F__)
+  template<>
+  struct Vec<16>
+  {
+    using Type = __m512;
+
+    static inline Type zero() { return _mm512_setzero_ps(); }
+    static inline Type load(const float* ptr) { return _mm512_load_ps(ptr); }
+    static inline Type broadcast(const float* ptr) { return _mm512_set1_ps(*ptr); }
+    static inline Type fmadd(Type a, Type b, Type c) { return _mm512_fmadd_ps(a, b, c); }
+    // The zero-masked form avoids the undefined pass-through value of
+    // _mm512_max_ps, which GCC reports as possibly uninitialized
+    static inline Type max(Type a, Type b) { return _mm512_maskz_max_ps(0xFFFF, a, b); }
+    static inline void store(float* ptr, Type a) { _mm512_store_ps(ptr, a); }
+  };
+#endif
+
+  // --------------------------------------------------------------------------
+  // Convolution
+  // --------------------------------------------------------------------------
+
+  // Number of output pixels computed together (kept in registers)
+  template<int K> struct ConvBlockWidth;
+  template<> struct ConvBlockWidth<8>  { static constexpr int value = 12; }; // 16 registers
+  template<> struct ConvBlockWidth<16> { static constexpr int value = 24; }; // 32 registers
+
+  // Computes R consecutive output pixels starting at (h, w0) for a block of
+  // output channels. Border blocks check the bounds of every pixel, and only
+  // the first n pixels are stored.
+  template<int K, int R, bool isBorder>
+  inline void convBlock(const ConvKernelParams& p, int ocb, int h, int w0, int n)
+  {
+    using V = Vec<K>;
+    using T = typename V::Type;
+
+    const int ICB = p.IC / K;
+    const size_t srcPlaneSize = size_t(p.H) * p.W * K;
+
+    T acc[R];
+    const T bias = V::load(p.bias + ocb*K);
+    for (int r = 0; r < R; ++r)
+      acc[r] = bias;
+
+    for (int icb = 0; icb < ICB; ++icb)
+    {
+      const float* srcPlane = p.src + icb * srcPlaneSize;
+      const float* weights = p.weights + (size_t(ocb) * ICB + icb) * (9*K*K);
+
+      for (int kh = 0; kh < 3; ++kh)
+      {
+        const int y = h + kh - 1;
+        if (y < 0 || y >= p.H)
+          continue;
+        const float* srcRow = srcPlane + size_t(y) * p.W * K;
+
+        for (int kw = 0; kw < 3; ++kw)
+        {
+          const float* w = weights + (kh*3 + kw) * (K*K);
+          const float* src = srcRow + (w0 + kw - 1) * K;
+
+          for (int ic = 0; ic < K; ++ic)
+          {
+            const T wv = V::load(w + ic*K);
+
+            for (int r = 0; r < R; ++r)
+            {
+              if (isBorder)
+              {
+                const int x = w0 + r + kw - 1;
+                if (r >= n || x < 0 || x >= p.W)
+                  continue;
+              }
+              acc[r] = V::fmadd(V::broadcast(src + r*K + ic), wv, acc[r]);
+            }
+          }
+        }
+      }
+    }
+
+    float* dst = p.dst + (size_t(ocb) * p.H + h) * p.W * K + size_t(w0) * K;
+    for (int r = 0; r < R; ++r)
+    {
+      if (isBorder && r >= n)
+        break;
+      const T value = p.relu ? V::max(acc[r], V::zero()) : acc[r];
+      V::store(dst + r*K, value);
+    }
+  }
+
+  template<int K>
+  inline void convRow(const ConvKernelParams& p, int ocb, int h)
+  {
+    constexpr int R = ConvBlockWidth<K>::value;
+
+    for (int w0 = 0; w0 < p.W; w0 += R)
+    {
+      const int n = minInt(R, p.W - w0);
+
+      // Interior blocks read the columns [w0-1, w0+R] without bounds checks
+      if (w0 >= 1 && w0 + R + 1 <= p.W)
+        convBlock<K, R, false>(p, ocb, h, w0, R);
+      else
+        convBlock<K, R, true>(p, ocb, h, w0, n);
+    }
+  }
+
+  // --------------------------------------------------------------------------
+  // Pooling
+  // --------------------------------------------------------------------------
+
+  template<int K>
+  inline void poolRow(const PoolKernelParams& p, int cb, int oh)
+  {
+    using V = Vec<K>;
+    using T = typename V::Type;
+
+    // Windows crossing the bottom/right edge (odd sizes) are clamped, which
+    // is equivalent to ignoring the padding
+    const int y0 = oh*2;
+    const int y1 = minInt(y0+1, p.H-1);
+
+    const float* srcPlane = p.src + size_t(cb) * p.H * p.W * K;
+    const float* srcRow0 = srcPlane + size_t(y0) * p.W * K;
+    const float* srcRow1 = srcPlane + size_t(y1) * p.W * K;
+    float* dstRow = p.dst + (size_t(cb) * p.OH + oh) * p.OW * K;
+
+    for (int ow = 0; ow < p.OW; ++ow)
+    {
+      const int x0 = ow*2;
+      const int x1 = minInt(x0+1, p.W-1);
+
+      const T a = V::max(V::load(srcRow0 + x0*K), V::load(srcRow0 + x1*K));
+      const T b = V::max(V::load(srcRow1 + x0*K), V::load(srcRow1 + x1*K));
+      V::store(dstRow + ow*K, V::max(a, b));
+    }
+  }
+
+} // namespace
+} // namespace oidn
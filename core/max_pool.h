@@ -0,0 +1,78 @@
+// ======================================================================== //
+// Copyright 2009-2019 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "node.h"
+#include "kernels.h"
+
+namespace oidn {
+
+  // 2x2 max pooling node with stride 2 using the built-in kernels (AVX2 or AVX-512)
+  // Odd source sizes are rounded up (ceil mode)
+  template<int K>
+  class MaxPoolNode : public Node
+  {
+    static_assert(K == 8 || K == 16, "unsupported block size");
+
+  private:
+    std::shared_ptr<memory> src;
+    std::shared_ptr<memory> dst;
+    bool fused; // computed by the preceding convolution
+
+  public:
+    MaxPoolNode(const std::shared_ptr<memory>& src,
+                const std::shared_ptr<memory>& dst,
+                bool fused = false)
+      : src(src),
+        dst(dst),
+        fused(fused)
+    {
+      assert(getTensorDims(src)[1] == getTensorDims(dst)[1]); // C
+      assert(getTensorDims(dst)[2] == (getTensorDims(src)[2] + 1) / 2); // H
+      assert(getTensorDims(dst)[3] == (getTensorDims(src)[3] + 1) / 2); // W
+    }
+
+    void execute() override
+    {
+      if (fused)
+        return;
+
+      const memory::dims srcDims = getTensorDims(src);
+      const memory::dims dstDims = getTensorDims(dst);
+
+      PoolKernelParams p;
+      p.src = (const float*)src->get_data_handle();
+      p.dst = (float*)dst->get_data_handle();
+      p.C   = srcDims[1];
+      p.H   = srcDims[2];
+      p.W   = srcDims[3];
+      p.OH  = dstDims[2];
+      p.OW  = dstDims[3];
+
+      parallel_nd(p.C / K, p.OH, [&](int cb, int oh)
+      {
+        if (K == 16)
+          executePoolKernel_avx512(p, cb, oh);
+        else
+          executePoolKernel_avx2(p, cb, oh);
+      });
+    }
+
+    std::shared_ptr<memory> getDst() const override { return dst; }
+  };
+
+} // namespace oidn
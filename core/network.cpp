@@ -16,22 +16,199 @@
 
 #include "upsample.h"
 #include "weights_reorder.h"
+#include "winograd.h"
+#include "direct_conv.h"
+#include "max_pool.h"
 #include "network.h"
 
 namespace oidn {
 
   template<int K>
-  Network<K>::Network(const std::map<std::string, Tensor>& weightMap)
+  Network<K>::Network(const std::map<std::string, Tensor>& weightMap, bool builtinKernels)
     : cpuEngine(engine::cpu, 0),
-      weightMap(weightMap)
+      weightMap(weightMap),
+      builtinKernels(builtinKernels)
   {
   }
 
   template<int K>
   void Network<K>::execute()
+  {
+    execute(0, nodes.size());
+  }
+
+  template<int K>
+  void Network<K>::execute(Progress& progress)
+  {
+    execute(0, nodes.size(), &progress);
+  }
+
+  template<int K>
+  void Network<K>::execute(size_t begin, size_t end, Progress* progress)
+  {
+    assert(begin <= end && end <= nodes.size());
+    allocScratch();
+
+    for (size_t i = begin; i < end; ++i)
+    {
+      if (profiler)
+      {
+        profiler->beginNode();
+        nodes[i]->execute();
+        profiler->endNode(i, nodeNames[i], 2 * nodes[i]->getWorkAmount()); // work amount = multiply-adds
+      }
+      else
+      {
+        nodes[i]->execute();
+      }
+
+      if (progress)
+        progress->update(nodes[i]->getWorkAmount());
+    }
+  }
+
+  template<int K>
+  void Network<K>::addNode(const std::string& name, const std::shared_ptr<Node>& node)
+  {
+    nodes.push_back(node);
+    nodeNames.push_back(name);
+  }
+
+  template<int K>
+  std::shared_ptr<Node> Network<K>::findNode(const std::string& name) const
   {
     for (size_t i = 0; i < nodes.size(); ++i)
-      nodes[i]->execute();
+    {
+      if (nodeNames[i] == name)
+        return nodes[i];
+    }
+    return nullptr;
+  }
+
+  template<int K>
+  double Network<K>::getWorkAmount() const
+  {
+    return getWorkAmount(0, nodes.size());
+  }
+
+  template<int K>
+  double Network<K>::getWorkAmount(size_t begin, size_t end) const
+  {
+    assert(begin <= end && end <= nodes.size());
+    double workAmount = 0;
+    for (size_t i = begin; i < end; ++i)
+      workAmount += nodes[i]->getWorkAmount();
+    return workAmount;
+  }
+
+  template<int K>
+  void Network<K>::releaseScratch()
+  {
+    for (auto& tensor : scratch)
+      tensor.buffer.reset();
+    scratchAllocated = false;
+  }
+
+  template<int K>
+  void Network<K>::allocScratch()
+  {
+    if (scratchAllocated)
+      return;
+
+    // Zero the tensors because some nodes assume that the padding is zero,
+    // which they initialize only once (e.g. the input reorder)
+    for (auto& tensor : scratch)
+    {
+      if (tensor.base < 0)
+      {
+        tensor.buffer = std::shared_ptr<char>((char*)alignedMalloc(tensor.byteSize, 64), alignedFree);
+        memset(tensor.buffer.get(), 0, tensor.byteSize);
+      }
+    }
+
+    for (auto& tensor : scratch)
+    {
+      const auto& owner = (tensor.base < 0) ? tensor : scratch[tensor.base];
+      tensor.mem->set_data_handle(owner.buffer.get() + tensor.byteOffset);
+    }
+
+    scratchAllocated = true;
+  }
+
+  template<int K>
+  size_t Network<K>::getScratchByteSize(bool residentOnly) const
+  {
+    if (residentOnly && !scratchAllocated)
+      return 0;
+
+    size_t byteSize = 0;
+    for (const auto& tensor : scratch)
+      byteSize += tensor.byteSize; // zero for the views
+    return byteSize;
+  }
+
+  template<int K>
+  size_t Network<K>::getWeightsByteSize() const
+  {
+    return weightsByteSize;
+  }
+
+  template<int K>
+  std::shared_ptr<memory> Network<K>::getScratchOwner(const std::shared_ptr<memory>& tensor, size_t& byteOffset) const
+  {
+    for (const auto& t : scratch)
+    {
+      if (t.mem == tensor)
+      {
+        byteOffset = t.byteOffset;
+        return (t.base < 0) ? t.mem : scratch[t.base].mem;
+      }
+    }
+
+    throw Exception(Error::Unknown, "tensor is not a scratch tensor");
+  }
+
+  template<int K>
+  void Network<K>::setScratchData(const std::shared_ptr<memory>& owner, void* data)
+  {
+    int base = -1;
+    for (size_t i = 0; i < scratch.size(); ++i)
+    {
+      if (scratch[i].mem == owner && scratch[i].base < 0)
+      {
+        base = int(i);
+        break;
+      }
+    }
+
+    if (base < 0)
+      throw Exception(Error::Unknown, "tensor is not an owning scratch tensor");
+
+    for (auto& tensor : scratch)
+    {
+      if (tensor.mem == owner || tensor.base == base)
+        tensor.mem->set_data_handle((char*)data + tensor.byteOffset);
+    }
+  }
+
+  template<int K>
+  void Network<K>::addScratchView(const std::shared_ptr<memory>& view,
+                                  const std::shared_ptr<memory>& src,
+                                  size_t srcOffset)
+  {
+    for (size_t i = 0; i < scratch.size(); ++i)
+    {
+      if (scratch[i].mem == src)
+      {
+        ScratchTensor tensor;
+        tensor.mem = view;
+        tensor.base = (scratch[i].base < 0) ? int(i) : scratch[i].base;
+        tensor.byteOffset = scratch[i].byteOffset + srcOffset * sizeof(float);
+        tensor.byteSize = 0;
+        scratch.push_back(tensor);
+        return;
+      }
+    }
   }
 
   template<int K>
@@ -39,6 +216,8 @@ namespace oidn {
                                                   memory::format format,
                                                   void* data)
   {
+    const bool isScratch = (data == nullptr && format == memory::format::any && dims.size() == 4);
+
     if (format == memory::format::any)
     {
       if (dims.size() == 4)
@@ -50,6 +229,22 @@ namespace oidn {
     }
     memory::desc desc(dims, memory::data_type::f32, format);
     memory::primitive_desc primDesc(desc, cpuEngine);
+
+    if (isScratch)
+    {
+      // The new tensor must be consistent with the existing ones
+      allocScratch();
+
+      ScratchTensor tensor;
+      tensor.base = -1;
+      tensor.byteOffset = 0;
+      tensor.byteSize = primDesc.get_size();
+      tensor.buffer = std::shared_ptr<char>((char*)alignedMalloc(tensor.byteSize, 64), alignedFree);
+      tensor.mem = std::make_shared<memory>(primDesc, tensor.buffer.get());
+      scratch.push_back(tensor);
+      return tensor.mem;
+    }
+
     if (data == nullptr)
       return std::make_shared<memory>(primDesc);
     else
@@ -71,7 +266,9 @@ namespace oidn {
     memory::desc desc(dims, memory::data_type::f32, BlockedFormat<K>::nChwKc);
     memory::primitive_desc primDesc(desc, cpuEngine);
     float* srcPtr = (float*)src->get_data_handle() + srcOffset;
-    return std::make_shared<memory>(primDesc, srcPtr);
+    auto dst = std::make_shared<memory>(primDesc, srcPtr);
+    addScratchView(dst, src, srcOffset);
+    return dst;
   }
 
   template<int K>
@@ -114,13 +311,36 @@ namespace oidn {
   template<int K>
   std::shared_ptr<Node> Network<K>::addConv(const std::string& name,
                                             const std::shared_ptr<memory>& src,
-                                            bool relu)
+                                            bool relu,
+                                            ConvAlgo algo)
   {
     const memory::dims strides = {1, 1};
     const memory::dims padding = {1, 1};
 
     memory::dims srcDims = getTensorDims(src);
 
+    // Share the already prepared weights of the same layer in another network
+    // (the tensors may have different spatial sizes)
+    std::shared_ptr<Node> sharedConv;
+    if (weightsNet)
+    {
+      sharedConv = weightsNet->findNode(name);
+      if (!sharedConv)
+        throw Exception(Error::InvalidOperation, "invalid shared convolution");
+
+      std::shared_ptr<Node> node;
+      if (auto conv = std::dynamic_pointer_cast<WinogradConvNode>(sharedConv))
+        node = std::make_shared<WinogradConvNode>(*conv, src, allocTensor(getConvDims(name, srcDims)));
+      else if (auto conv = std::dynamic_pointer_cast<DirectConvNode<K>>(sharedConv))
+        node = std::make_shared<DirectConvNode<K>>(*conv, src, allocTensor(getConvDims(name, srcDims)));
+
+      if (node)
+      {
+        addNode(name, node);
+        return node;
+      }
+    }
+
     // Get the weights
     const auto& W = weightMap[name + "/W"];
     if (W.ndims() != 4 || W.format != "oihw")
@@ -155,11 +375,37 @@ namespace oidn {
     auto dst = allocTensor(dstDims);
     assert(getTensorDims(dst) == dstDims);
 
+    // Select the convolution algorithm
+    // MKL-DNN supports Winograd only for nChw16c, so we use our own implementation for nChw8c
+    // It is not worth using our Winograd for the layers with very few input
+    // channels (e.g. conv1, which has at most 9), so the unpadded number of
+    // input channels is checked (9 channels are padded to 16)
+    // If the poolings are fused, the built-in direct convolutions are used,
+    // because only these support fusion
+    if (algo == ConvAlgo::Auto)
+      algo = (!isPoolFusionEnabled() && (K == 16 || weightsDims[1] >= 16)) ? ConvAlgo::Winograd : ConvAlgo::Direct;
+
+    if (K == 8 && algo == ConvAlgo::Winograd && mayiuse(avx2))
+    {
+      auto node = std::make_shared<WinogradConvNode>(src, weightsPad, bias, dst, relu);
+      weightsByteSize += (getWinogradWeightsSize(weightsPadDims[0], weightsPadDims[1]) + getTensorSize(bias)) * sizeof(float);
+      addNode(name, node);
+      return node;
+    }
+
+    if (builtinKernels)
+    {
+      auto node = std::make_shared<DirectConvNode<K>>(src, weightsPad, bias, dst, relu);
+      weightsByteSize += (getTensorSize(weightsPad) + getTensorSize(bias)) * sizeof(float);
+      addNode(name, node);
+      return node;
+    }
+
     // Create a convolution
     // Let the convolution primitive choose the weights format
     auto weightsDesc = memory::desc({ weightsPadDims }, memory::data_type::f32, memory::format::any);
 
-    auto convAlgo = (K == 16) ? convolution_winograd : convolution_direct;
+    auto convAlgo = (K == 16 && algo == ConvAlgo::Winograd) ? convolution_winograd : convolution_direct;
     auto convDesc = convolution_forward::desc(
       prop_kind::forward_inference, convAlgo,
       src->get_primitive_desc().desc(),
@@ -184,26 +430,38 @@ namespace oidn {
 
     auto convPrimDesc = convolution_forward::primitive_desc(convDesc, convAttr, cpuEngine);
 
-    // Reorder the weights to the final format, if necessary
+    // Share the weights if the convolution chose the same format for them
     auto weights = weightsPad;
-    if (memory::primitive_desc(convPrimDesc.weights_primitive_desc()) != weightsPad->get_primitive_desc())
+    auto sharedMklConv = std::dynamic_pointer_cast<ConvNode>(sharedConv);
+    if (sharedMklConv && memory::primitive_desc(convPrimDesc.weights_primitive_desc()) == sharedMklConv->getWeights()->get_primitive_desc())
     {
-      weights = std::make_shared<memory>(convPrimDesc.weights_primitive_desc());
-      MklNode(reorder(*weightsPad, *weights)).execute();
+      weights = sharedMklConv->getWeights();
+      bias = sharedMklConv->getBias();
+    }
+    else
+    {
+      // Reorder the weights to the final format, if necessary
+      if (memory::primitive_desc(convPrimDesc.weights_primitive_desc()) != weightsPad->get_primitive_desc())
+      {
+        weights = std::make_shared<memory>(convPrimDesc.weights_primitive_desc());
+        MklNode(reorder(*weightsPad, *weights)).execute();
+      }
+      weightsByteSize += weights->get_primitive_desc().get_size() + getTensorSize(bias) * sizeof(float);
     }
 
     // Create convolution node and add it to the net
     auto node = std::make_shared<ConvNode>(convPrimDesc, src, weights, bias, dst);
-    nodes.push_back(node);
+    addNode(name, node);
     return node;
   }
 
   template<int K>
   memory::dims Network<K>::getPoolDims(const memory::dims& srcDims)
   {
+    // Round up odd sizes (ceil mode), so no spatial padding of the input is needed
     memory::dims dstDims = srcDims;
-    dstDims[2] /= 2; // H/2
-    dstDims[3] /= 2; // W/2
+    dstDims[2] = (srcDims[2] + 1) / 2; // H/2
+    dstDims[3] = (srcDims[3] + 1) / 2; // W/2
     return dstDims;
   }
 
@@ -213,25 +471,42 @@ namespace oidn {
   {
     const memory::dims kernel  = {2, 2};
     const memory::dims strides = {2, 2};
-    const memory::dims padding = {0, 0};
 
     memory::dims srcDims = getTensorDims(src);
     memory::dims dstDims = getPoolDims(srcDims);
 
+    // Pad odd sizes on the bottom/right (the padding is ignored by max pooling)
+    const memory::dims paddingL = {0, 0};
+    const memory::dims paddingR = {dstDims[2]*2 - srcDims[2], dstDims[3]*2 - srcDims[3]};
+
     auto dst = userDst;
     if (!dst)
       dst = allocTensor(dstDims);
     assert(getTensorDims(dst) == dstDims);
 
+    if (builtinKernels)
+    {
+      // Fuse the pooling into the preceding convolution if executing on a
+      // single thread, which has better cache locality but less parallelism
+      auto conv = nodes.empty() ? nullptr : std::dynamic_pointer_cast<DirectConvNode<K>>(nodes.back());
+      const bool fused = conv && conv->getDst() == src && isPoolFusionEnabled();
+      if (fused)
+        conv->fusePool(dst);
+
+      auto node = std::make_shared<MaxPoolNode<K>>(src, dst, fused);
+      addNode("pool", node);
+      return node;
+    }
+
     auto poolDesc = pooling_forward::desc(
       prop_kind::forward_inference, pooling_max,
       src->get_primitive_desc().desc(),
       dst->get_primitive_desc().desc(),
-      strides, kernel, padding, padding, padding_kind::zero);
+      strides, kernel, paddingL, paddingR, padding_kind::zero);
     auto poolPrimDesc = pooling_forward::primitive_desc(poolDesc, cpuEngine);
 
     auto node = std::make_shared<PoolNode>(poolPrimDesc, src, dst);
-    nodes.push_back(node);
+    addNode("pool", node);
     return node;
   }
 
@@ -244,21 +519,33 @@ namespace oidn {
     return dstDims;
   }
 
+  template<int K>
+  memory::dims Network<K>::getUpsampleDims(const memory::dims& srcDims, const memory::dims& cropDims)
+  {
+    // Crop to the spatial size of the tensor which was pooled in ceil mode
+    memory::dims dstDims = getUpsampleDims(srcDims);
+    assert(cropDims[2] <= dstDims[2] && cropDims[2] >= dstDims[2]-1);
+    assert(cropDims[3] <= dstDims[3] && cropDims[3] >= dstDims[3]-1);
+    dstDims[2] = cropDims[2]; // H
+    dstDims[3] = cropDims[3]; // W
+    return dstDims;
+  }
+
   template<int K>
   std::shared_ptr<Node> Network<K>::addUpsample(const std::shared_ptr<memory>& src,
                                                 const std::shared_ptr<memory>& userDst)
   {
     memory::dims srcDims = getTensorDims(src);
-    memory::dims dstDims = getUpsampleDims(srcDims);
 
+    // The destination may be cropped
     auto dst = userDst;
     if (!dst)
-      dst = allocTensor(dstDims);
-    assert(getTensorDims(dst) == dstDims);
+      dst = allocTensor(getUpsampleDims(srcDims));
+    assert(getTensorDims(dst) == getUpsampleDims(srcDims, getTensorDims(dst)));
 
     // Create upsampling node and add it to net
     auto node = std::make_shared<UpsampleNode<K>>(src, dst);
-    nodes.push_back(node);
+    addNode("upsample", node);
     return node;
   }
 
@@ -19,18 +19,65 @@
 #include "node.h"
 #include "input_reorder.h"
 #include "output_reorder.h"
+#include "progress.h"
+#include "profiler.h"
 
 #pragma once
 
 namespace oidn {
 
-  template<int K>
-  class Network : public Node
+  // Network interface independent of the block size
+  class Executable
   {
   public:
-    Network(const std::map<std::string, Tensor>& weight_map);
-    void execute() override;
+    virtual ~Executable() = default;
+    virtual void execute(Progress& progress) = 0;
+    virtual double getWorkAmount() const = 0;
+
+    // Releases the scratch tensors (e.g. activations) while keeping the
+    // weights and the primitives, or re-allocates them
+    // The scratch tensors are re-allocated automatically on execution.
+    virtual void releaseScratch() = 0;
+    virtual void allocScratch() = 0;
+
+    // Returns the total size of the scratch tensors (0 if released and residentOnly is true)
+    virtual size_t getScratchByteSize(bool residentOnly = false) const = 0;
+
+    // Returns the size of the prepared weights and biases owned by the network
+    // (excluding the ones shared with another network), which are never released
+    virtual size_t getWeightsByteSize() const = 0;
+  };
 
+  template<int K>
+  class Network : public Executable
+  {
+  public:
+    // If builtinKernels is true, the convolutions and poolings are executed
+    // with the built-in kernels instead of MKL-DNN (requires AVX2)
+    Network(const std::map<std::string, Tensor>& weightMap, bool builtinKernels = false);
+    void execute();
+    void execute(Progress& progress) override;
+    double getWorkAmount() const override;
+    void releaseScratch() override;
+    void allocScratch() override;
+    size_t getScratchByteSize(bool residentOnly = false) const override;
+    size_t getWeightsByteSize() const override;
+
+    // Executes only the nodes in the range [begin, end)
+    void execute(size_t begin, size_t end, Progress* progress = nullptr);
+    double getWorkAmount(size_t begin, size_t end) const;
+    size_t getNumNodes() const { return nodes.size(); }
+    const std::shared_ptr<Node>& getNode(size_t i) const { return nodes[i]; }
+
+    // Returns the first node with the specified name (or null if not found)
+    std::shared_ptr<Node> findNode(const std::string& name) const;
+
+    // Shares the weights of the convolutions added later with the layers of
+    // the same name in another network, which must have been built already
+    void shareWeights(const std::shared_ptr<Network>& other) { weightsNet = other; }
+
+    // Tensors in the blocked format allocated by the network (without user
+    // data) are scratch tensors, which may be released when idle
     std::shared_ptr<memory> allocTensor(const memory::dims& dims,
                                         memory::format format = memory::format::any,
                                         void* data = nullptr);
@@ -45,6 +92,14 @@ namespace oidn {
 
     void zeroTensor(const std::shared_ptr<memory>& dst);
 
+    // Returns the scratch tensor owning the data of a tensor (itself if it is
+    // not a view) and the byte offset of the tensor in the owner
+    std::shared_ptr<memory> getScratchOwner(const std::shared_ptr<memory>& tensor, size_t& byteOffset) const;
+
+    // Points an owning scratch tensor and its views to another buffer with the
+    // same size (e.g. for double buffering), until the scratch is re-allocated
+    void setScratchData(const std::shared_ptr<memory>& owner, void* data);
+
     memory::dims getInputReorderDims(const memory::dims& srcDims, int spatialPad);
 
     template<class TransferFunc>
@@ -53,7 +108,8 @@ namespace oidn {
                                           const Image& normal,
                                           const std::shared_ptr<TransferFunc>& transferFunc,
                                           int spatialPad,
-                                          const std::shared_ptr<memory>& userDst = nullptr);
+                                          const std::shared_ptr<memory>& userDst = nullptr,
+                                          InputAnalyzer* analyzer = nullptr);
 
     template<class TransferFunc>
     std::shared_ptr<Node> addOutputReorder(const std::shared_ptr<memory>& src,
@@ -63,22 +119,54 @@ namespace oidn {
     memory::dims getConvDims(const std::string& name, const memory::dims& srcDims);
     std::shared_ptr<Node> addConv(const std::string& name,
                                   const std::shared_ptr<memory>& src,
-                                  bool relu = true);
+                                  bool relu = true,
+                                  ConvAlgo algo = ConvAlgo::Auto);
 
     memory::dims getPoolDims(const memory::dims& srcDims);
     std::shared_ptr<Node> addPool(const std::shared_ptr<memory>& src,
                                   const std::shared_ptr<memory>& userDst = nullptr);
 
     memory::dims getUpsampleDims(const memory::dims& srcDims);
+    memory::dims getUpsampleDims(const memory::dims& srcDims, const memory::dims& cropDims);
     std::shared_ptr<Node> addUpsample(const std::shared_ptr<memory>& src,
                                       const std::shared_ptr<memory>& userDst = nullptr);
 
     memory::dims getConcatDims(const memory::dims& src1Dims, const memory::dims& src2Dims);
 
+    // Enables profiling the nodes (if not null)
+    void setProfiler(const std::shared_ptr<Profiler>& profiler) { this->profiler = profiler; }
+
   private:
+    void addNode(const std::string& name, const std::shared_ptr<Node>& node);
+    void addScratchView(const std::shared_ptr<memory>& view, const std::shared_ptr<memory>& src, size_t srcOffset);
+
+    // Returns whether the poolings are fused into the preceding convolutions
+    // (with the built-in kernels on a single thread)
+    bool isPoolFusionEnabled() const { return builtinKernels && tbb::this_task_arena::max_concurrency() == 1; }
+
     engine cpuEngine;
     std::vector<std::shared_ptr<Node>> nodes;
+    std::vector<std::string> nodeNames;
     std::map<std::string, Tensor> weightMap;
+    std::shared_ptr<Profiler> profiler;
+    std::shared_ptr<Network> weightsNet; // network sharing its weights (optional)
+    bool builtinKernels;
+
+    // Scratch tensors and views of them (e.g. the inputs of the concats),
+    // which are rebased when the scratch tensors are re-allocated
+    struct ScratchTensor
+    {
+      std::shared_ptr<memory> mem;
+      int base;                     // index of the owning tensor (-1 if this is the owner)
+      size_t byteOffset;            // offset in the owning tensor
+      size_t byteSize;
+      std::shared_ptr<char> buffer; // data of the owner (null if released)
+    };
+
+    std::vector<ScratchTensor> scratch;
+    bool scratchAllocated = true;
+
+    size_t weightsByteSize = 0; // prepared weights and biases owned by the network
   };
 
 
@@ -89,7 +177,8 @@ namespace oidn {
                                                     const Image& normal,
                                                     const std::shared_ptr<TransferFunc>& transferFunc,
                                                     int spatialPad,
-                                                    const std::shared_ptr<memory>& userDst)
+                                                    const std::shared_ptr<memory>& userDst,
+                                                    InputAnalyzer* analyzer)
   {
     assert(color);
     int inputC = 3;
@@ -106,8 +195,8 @@ namespace oidn {
     assert(getTensorDims(dst) == dstDims);
 
     // Push node
-    auto node = std::make_shared<InputReorderNode<K, TransferFunc>>(color, albedo, normal, dst, transferFunc);
-    nodes.push_back(node);
+    auto node = std::make_shared<InputReorderNode<K, TransferFunc>>(color, albedo, normal, dst, transferFunc, analyzer);
+    addNode("input_reorder", node);
     return node;
   }
 
@@ -122,7 +211,7 @@ namespace oidn {
 
     // Push node
     auto node = std::make_shared<OutputReorderNode<K, TransferFunc>>(src, output, transferFunc);
-    nodes.push_back(node);
+    addNode("output_reorder", node);
     return node;
   }
 
@@ -27,8 +27,32 @@ namespace oidn {
     virtual ~Node() = default;
     virtual void execute() = 0;
     virtual std::shared_ptr<memory> getDst() const { return nullptr; }
+
+    // Returns the estimated amount of work (for progress monitoring)
+    virtual double getWorkAmount() const { return 0; }
   };
 
+  // Returns the number of multiply-adds of a convolution
+  inline double getConvWorkAmount(const memory::dims& weightsDims, // OIHW
+                                  const memory::dims& dstDims)     // NCHW
+  {
+    return double(dstDims[0]) * dstDims[2] * dstDims[3] *
+           double(weightsDims[0]) * weightsDims[1] * weightsDims[2] * weightsDims[3];
+  }
+
+  inline double getConvWorkAmount(const std::shared_ptr<memory>& weights,
+                                  const std::shared_ptr<memory>& dst)
+  {
+    return getConvWorkAmount(getTensorDims(weights), getTensorDims(dst));
+  }
+
+  // Returns the number of multiply-adds of a 3x3 convolution
+  inline double getConv3x3WorkAmount(const std::shared_ptr<memory>& src,
+                                     const std::shared_ptr<memory>& dst)
+  {
+    return getConvWorkAmount({getTensorDims(dst)[1], getTensorDims(src)[1], 3, 3}, getTensorDims(dst));
+  }
+
   // Node wrapping an MKL-DNN primitive
   class MklNode : public Node
   {
@@ -65,7 +89,11 @@ namespace oidn {
       : MklNode(convolution_forward(desc, *src, *weights, *bias, *dst)),
         src(src), weights(weights), bias(bias), dst(dst) {}
 
+    const std::shared_ptr<memory>& getWeights() const { return weights; }
+    const std::shared_ptr<memory>& getBias() const { return bias; }
+
     std::shared_ptr<memory> getDst() const override { return dst; }
+    double getWorkAmount() const override { return getConvWorkAmount(weights, dst); }
   };
 
   // Pooling node
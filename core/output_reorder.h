@@ -63,37 +63,81 @@ namespace oidn {
 
     void execute() override
     {
-      const int C1 = K;
+      // The source may have been re-allocated
+      srcPtr = (float*)src->get_data_handle();
+
       const int H2 = output.height;
       const int W2 = output.width;
 
-      parallel_nd(H2, [&](int h)
+      // Images with padded rows are written in aligned blocks of pixels with
+      // streaming stores, without handling the edges of the rows
+      if (output.padded)
       {
-        for (int w = 0; w < W2; ++w)
+        parallel_nd(H2, [&](int h)
         {
-          float* dstPtr_C = (float*)output.get(h, w);
-
-          // Source is in nChwKc format. In this case C is 1 so this is really nhwc
-          const float* srcPtr_C = srcPtr + h*W1*C1 + w*C1;
+          alignas(imageAlignment) float block[imageRowPadding*3];
+          float* dstPtr_W = (float*)output.get(h, 0);
 
-          #pragma unroll
-          for (int i = 0; i < 3; ++i)
+          for (int w0 = 0; w0 < W2; w0 += imageRowPadding)
           {
-            // Load the value
-            float x = srcPtr_C[i];
+            // Fill the padding with the last pixel of the row
+            for (int i = 0; i < imageRowPadding; ++i)
+              loadPixel(h, min(w0 + i, W2-1), &block[i*3]);
 
-            // The CNN output may contain negative values or even NaNs, so it must be sanitized
-            x = isfinite(x) ? max(x, 0.f) : 0.f;
+            float* dstPtr_C = dstPtr_W + w0*3;
+            for (int i = 0; i < imageRowPadding*3; i += 4)
+              _mm_stream_ps(dstPtr_C + i, _mm_load_ps(&block[i]));
+          }
 
-            // Apply the inverse transfer function
-            x = transferFunc->inverse(x);
+          _mm_sfence();
+        });
+        return;
+      }
 
-            // Store the value
-            dstPtr_C[i] = x;
-          }
-        }
+      parallel_nd(H2, [&](int h)
+      {
+        for (int w = 0; w < W2; ++w)
+          loadPixel(h, w, (float*)output.get(h, w));
       });
     }
+
+    // Sets a new output image, which must have the same dimensions as the original one
+    void setDst(const Image& output)
+    {
+      assert(output.width == this->output.width && output.height == this->output.height);
+      this->output = output;
+    }
+
+    void setTransferFunc(const std::shared_ptr<TransferFunc>& transferFunc)
+    {
+      this->transferFunc = transferFunc;
+    }
+
+  private:
+    // Loads a pixel from the source, and stores the output color
+    __forceinline void loadPixel(int h, int w, float* dstPtr_C)
+    {
+      const int C1 = K;
+
+      // Source is in nChwKc format. In this case C is 1 so this is really nhwc
+      const float* srcPtr_C = srcPtr + h*W1*C1 + w*C1;
+
+      #pragma unroll
+      for (int i = 0; i < 3; ++i)
+      {
+        // Load the value
+        float x = srcPtr_C[i];
+
+        // The CNN output may contain negative values or even NaNs, so it must be sanitized
+        x = isfinite(x) ? max(x, 0.f) : 0.f;
+
+        // Apply the inverse transfer function
+        x = transferFunc->inverse(x);
+
+        // Store the value
+        dstPtr_C[i] = x;
+      }
+    }
   };
 
 } // namespace oidn
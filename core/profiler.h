@@ -0,0 +1,155 @@
+// ======================================================================== //
+// Copyright 2009-2019 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "common.h"
+#include "common/timer.h"
+#include "common/perf_counters.h"
+#include <iomanip>
+
+namespace oidn {
+
+  // Measures the execution time and hardware performance counters of the nodes
+  // of a network, and prints a report with a roofline-style classification
+  class Profiler
+  {
+  private:
+    struct NodeStats
+    {
+      std::string name;
+      int count = 0;    // number of executions
+      double time = 0;  // seconds
+      double flops = 0; // floating-point operations
+      PerfCounterValues counters;
+    };
+
+    std::shared_ptr<PerfCounters> perfCounters;
+    std::vector<NodeStats> nodeStats;
+
+    Timer timer;
+    PerfCounterValues beginCounters;
+
+  public:
+    explicit Profiler(const std::shared_ptr<PerfCounters>& perfCounters)
+      : perfCounters(perfCounters) {}
+
+    void beginNode()
+    {
+      beginCounters = perfCounters->read();
+      timer.reset();
+    }
+
+    void endNode(size_t index, const std::string& name, double flops)
+    {
+      const double time = timer.query();
+      const PerfCounterValues counters = perfCounters->read() - beginCounters;
+
+      if (index >= nodeStats.size())
+        nodeStats.resize(index+1);
+      NodeStats& stats = nodeStats[index];
+      stats.name = name;
+      stats.count++;
+      stats.time += time;
+      stats.flops += flops;
+      stats.counters += counters;
+    }
+
+    void reset()
+    {
+      nodeStats.clear();
+    }
+
+    void print(std::ostream& out) const
+    {
+      constexpr double cacheLineSize = 64;
+      const bool hasCounters = perfCounters->isAvailable();
+      const bool hasBytes = perfCounters->hasCacheMissCounter();
+
+      // Determine the attainable compute and memory throughput from the best
+      // nodes, the ratio of which is the ridge point of the roofline
+      double maxFlopRate = 0;
+      double maxByteRate = 0;
+      for (const auto& stats : nodeStats)
+      {
+        if (stats.count == 0 || stats.time <= 0)
+          continue;
+        maxFlopRate = max(maxFlopRate, stats.flops / stats.time);
+        maxByteRate = max(maxByteRate, stats.counters.cacheMisses * cacheLineSize / stats.time);
+      }
+      const double ridge = (maxByteRate > 0) ? (maxFlopRate / maxByteRate) : 0;
+
+      const std::ios::fmtflags flags = out.flags();
+      out << std::fixed;
+      out << "Node                   Time [ms]  GFLOP/s";
+      if (hasCounters)
+        out << "   IPC   GB/s  FLOP/B  Bound";
+      out << std::endl;
+
+      double totalTime = 0;
+      for (size_t i = 0; i < nodeStats.size(); ++i)
+      {
+        const NodeStats& stats = nodeStats[i];
+        if (stats.count == 0)
+          continue;
+
+        const double time = stats.time / stats.count;
+        const double flopRate = stats.flops / stats.time;
+        totalTime += time;
+
+        out << std::left << std::setw(3) << i << std::setw(18) << stats.name << std::right
+            << std::setprecision(3) << std::setw(11) << time * 1000.
+            << std::setprecision(1) << std::setw(9) << flopRate * 1e-9;
+
+        if (hasCounters)
+        {
+          const PerfCounterValues& counters = stats.counters;
+          if (perfCounters->hasInstructionCounter() && counters.cycles > 0)
+            out << std::setprecision(2) << std::setw(6) << double(counters.instructions) / counters.cycles;
+          else
+            out << std::setw(6) << "-";
+
+          if (hasBytes)
+          {
+            // Estimate the DRAM traffic from the last level cache misses
+            const double bytes = counters.cacheMisses * cacheLineSize;
+            const double intensity = (bytes > 0) ? (stats.flops / bytes) : 0;
+            out << std::setprecision(1) << std::setw(7) << bytes / stats.time * 1e-9;
+            if (bytes > 0)
+              out << std::setprecision(1) << std::setw(8) << intensity;
+            else
+              out << std::setw(8) << "-";
+            if (stats.flops > 0 && bytes > 0)
+              out << "  " << ((intensity >= ridge) ? "compute" : "memory");
+            else
+              out << "  " << ((stats.flops > 0) ? "compute" : "memory");
+          }
+        }
+
+        out << std::endl;
+      }
+
+      out << std::setprecision(3) << "Total: " << totalTime * 1000. << " ms";
+      if (hasBytes && ridge > 0)
+        out << std::setprecision(1) << ", ridge point: " << ridge << " FLOP/B";
+      if (!hasCounters)
+        out << " (hardware performance counters not available)";
+      out << std::endl;
+      out.flags(flags);
+    }
+  };
+
+} // namespace oidn
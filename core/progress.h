@@ -0,0 +1,65 @@
+// ======================================================================== //
+// Copyright 2009-2019 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "device.h"
+
+namespace oidn {
+
+  // Reports the progress of an execution to the user's progress monitor
+  // function, and cancels the execution if requested
+  // Every update is also a point where the execution can be preempted by
+  // higher priority executions on the same device.
+  class Progress
+  {
+  private:
+    Device* device;
+    ProgressMonitorFunction func;
+    void* userPtr;
+    double total;   // total amount of work
+    double current; // amount of work done so far
+
+  public:
+    Progress(Device* device, ProgressMonitorFunction func, void* userPtr, double total)
+      : device(device), func(func), userPtr(userPtr), total(total), current(0)
+    {
+      update(0);
+    }
+
+    // Notifies the progress monitor that the specified amount of work was done
+    // Throws an exception if the execution should be cancelled
+    void update(double done)
+    {
+      device->yieldExecution();
+
+      if (!func)
+        return;
+
+      current = min(current + done, total);
+      const double n = (total > 0) ? (current / total) : 1.;
+      if (!func(userPtr, n))
+        throw Exception(Error::Cancelled, "execution was cancelled");
+    }
+
+    // Notifies the progress monitor that all work was done
+    void finish()
+    {
+      update(total - current);
+    }
+  };
+
+} // namespace oidn
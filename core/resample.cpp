@@ -0,0 +1,96 @@
+// ======================================================================== //
+// Copyright 2009-2019 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "resample.h"
+
+namespace oidn {
+
+  void downsampleImage(const Image& src, const Image& dst, int scale)
+  {
+    assert(src.format == Format::Float3 && dst.format == Format::Float3);
+    assert(dst.width  == (src.width  + scale - 1) / scale);
+    assert(dst.height == (src.height + scale - 1) / scale);
+
+    parallel_nd(dst.height, [&](int h)
+    {
+      const int beginH = h * scale;
+      const int endH   = min(beginH + scale, src.height);
+
+      for (int w = 0; w < dst.width; ++w)
+      {
+        const int beginW = w * scale;
+        const int endW   = min(beginW + scale, src.width);
+
+        float sum[3] = {0.f, 0.f, 0.f};
+        for (int y = beginH; y < endH; ++y)
+        {
+          for (int x = beginW; x < endW; ++x)
+          {
+            const float* srcPtr = (const float*)src.get(y, x);
+            for (int c = 0; c < 3; ++c)
+              sum[c] += srcPtr[c];
+          }
+        }
+
+        // The blocks on the right and bottom edges may be partial
+        const float rcpCount = 1.f / float((endH - beginH) * (endW - beginW));
+        float* dstPtr = (float*)dst.get(h, w);
+        for (int c = 0; c < 3; ++c)
+          dstPtr[c] = sum[c] * rcpCount;
+      }
+    });
+  }
+
+  void upsampleImage(const Image& src, const Image& dst)
+  {
+    assert(src.format == Format::Float3 && dst.format == Format::Float3);
+    assert(src.width > 0 && src.height > 0);
+
+    const float scaleX = float(src.width)  / float(dst.width);
+    const float scaleY = float(src.height) / float(dst.height);
+
+    parallel_nd(dst.height, [&](int h)
+    {
+      // Map the pixel centers to the source
+      const float y = max((float(h) + 0.5f) * scaleY - 0.5f, 0.f);
+      const int y0 = min(int(y), src.height - 1);
+      const int y1 = min(y0 + 1, src.height - 1);
+      const float ty = y - float(y0);
+
+      for (int w = 0; w < dst.width; ++w)
+      {
+        const float x = max((float(w) + 0.5f) * scaleX - 0.5f, 0.f);
+        const int x0 = min(int(x), src.width - 1);
+        const int x1 = min(x0 + 1, src.width - 1);
+        const float tx = x - float(x0);
+
+        const float* p00 = (const float*)src.get(y0, x0);
+        const float* p01 = (const float*)src.get(y0, x1);
+        const float* p10 = (const float*)src.get(y1, x0);
+        const float* p11 = (const float*)src.get(y1, x1);
+
+        float* dstPtr = (float*)dst.get(h, w);
+        for (int c = 0; c < 3; ++c)
+        {
+          const float v0 = p00[c] + (p01[c] - p00[c]) * tx;
+          const float v1 = p10[c] + (p11[c] - p10[c]) * tx;
+          dstPtr[c] = v0 + (v1 - v0) * ty;
+        }
+      }
+    });
+  }
+
+} // namespace oidn
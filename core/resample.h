@@ -0,0 +1,32 @@
+// ======================================================================== //
+// Copyright 2009-2019 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "image.h"
+
+namespace oidn {
+
+  // Downsamples a Float3 image by an integer factor using a box filter
+  // The size of the destination must be the size of the source divided by
+  // the factor, rounded up.
+  void downsampleImage(const Image& src, const Image& dst, int scale);
+
+  // Upsamples a Float3 image to the size of the destination using bilinear
+  // interpolation
+  void upsampleImage(const Image& src, const Image& dst);
+
+} // namespace oidn
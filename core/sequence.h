@@ -0,0 +1,513 @@
+// ======================================================================== //
+// Copyright 2009-2019 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "device.h"
+#include "network.h"
+#include "temporal.h"
+#include <functional>
+
+namespace oidn {
+
+  // Returns an image with the same layout as the specified image of the
+  // filter but with the data of a frame
+  inline Image getFrameImage(const Image& image, void* ptr)
+  {
+    if (!image)
+    {
+      if (ptr != nullptr)
+        throw Exception(Error::InvalidArgument, "frame has an image which is not set for the filter");
+      return Image();
+    }
+
+    if (ptr == nullptr)
+      throw Exception(Error::InvalidArgument, "frame image pointer null");
+
+    Image frameImage = image;
+    frameImage.ptr = (char*)ptr;
+    frameImage.buffer = nullptr;
+    frameImage.padded = false;
+    return frameImage;
+  }
+
+  // Executes a network on a sequence of frames in a pipelined fashion
+  // The input processing of frame N+1 and the output processing of frame N-1
+  // are overlapped with the network of frame N, using separate arenas and
+  // double-buffered input/output tensors.
+  class SequencePipeline
+  {
+  public:
+    virtual ~SequencePipeline() = default;
+    virtual void execute(const Frame* frames, size_t numFrames,
+                         ProgressMonitorFunction progressFunc, void* progressUserPtr) = 0;
+
+    // Releases the scratch tensors, which are re-allocated on execution
+    virtual void releaseScratch() = 0;
+
+    // Returns the size of the scratch tensors not owned by the network of the
+    // filter (0 if released and residentOnly is true)
+    virtual size_t getScratchByteSize(bool residentOnly = false) const = 0;
+  };
+
+  template<int K, class TransferFunc>
+  class SequencePipelineImpl : public SequencePipeline
+  {
+  private:
+    static constexpr int numBuffers = 2;
+    static constexpr int numTransferFuncs = 3; // a frame is in flight for 3 steps
+
+    // Tensor of the network which is double-buffered without copying, by
+    // pointing the scratch tensor owning its data to the buffer of the frame
+    // The first buffer is the original data of the owner, the second one is
+    // allocated by the pipeline.
+    struct SwapTensor
+    {
+      std::shared_ptr<memory> owner;             // scratch tensor owning the data (e.g. the concat containing the input)
+      size_t byteOffset = 0;                     // offset of the tensor in the owner
+      std::shared_ptr<memory> buffer;            // second buffer with the same size as the owner
+      char* data[numBuffers];                    // data of the owner in each buffer
+      std::shared_ptr<memory> views[numBuffers]; // the tensor in each buffer (accessed by the I/O stages)
+    };
+
+    Ref<Device> device;
+    std::shared_ptr<Network<K>> net;
+
+    // The images of the frames must have the same layout as these
+    Image color;
+    Image albedo;
+    Image normal;
+    Image output;
+    Image motion;
+
+    std::shared_ptr<TemporalNode> temporal; // blends the outputs with the history (optional)
+
+    std::shared_ptr<memory> netInput;  // input of the first network node after the input reorder
+    std::shared_ptr<memory> netOutput; // output of the last network node before the output reorder
+
+    InputAnalyzer* analyzer; // prepares the transfer function of each frame (e.g. computes the exposure)
+    std::shared_ptr<TransferFunc> transferFuncs[numTransferFuncs];
+
+    // Pipeline stages, allocated on first use
+    bool initialized = false;
+    SwapTensor inputSwap;
+    SwapTensor outputSwap;
+    std::shared_ptr<InputReorderNode<K, TransferFunc>> inputReorders[numBuffers];
+    std::shared_ptr<OutputReorderNode<K, TransferFunc>> outputReorders[numBuffers];
+
+    WorkerThread ioThread; // executes the I/O stages concurrently with the network stage
+
+  public:
+    SequencePipelineImpl(const Ref<Device>& device,
+                         const std::shared_ptr<Network<K>>& net,
+                         const Image& color,
+                         const Image& albedo,
+                         const Image& normal,
+                         const Image& output,
+                         const Image& motion,
+                         const std::shared_ptr<TemporalNode>& temporal,
+                         const std::shared_ptr<memory>& netInput,
+                         const std::shared_ptr<memory>& netOutput,
+                         InputAnalyzer* analyzer = nullptr)
+      : device(device), net(net),
+        color(color), albedo(albedo), normal(normal), output(output), motion(motion),
+        temporal(temporal),
+        netInput(netInput), netOutput(netOutput),
+        analyzer(analyzer)
+    {
+      for (int i = 0; i < numTransferFuncs; ++i)
+        transferFuncs[i] = std::make_shared<TransferFunc>();
+    }
+
+    void execute(const Frame* frames, size_t numFrames,
+                 ProgressMonitorFunction progressFunc, void* progressUserPtr) override
+    {
+      if (numFrames == 0)
+        return;
+
+      // Get the images of all frames first to catch any errors before execution
+      std::vector<Image> colors(numFrames), albedos(numFrames), normals(numFrames), outputs(numFrames), motions(numFrames);
+      for (size_t i = 0; i < numFrames; ++i)
+      {
+        colors[i]  = getFrameImage(color,  frames[i].color);
+        albedos[i] = getFrameImage(albedo, frames[i].albedo);
+        normals[i] = getFrameImage(normal, frames[i].normal);
+        outputs[i] = getFrameImage(output, frames[i].output);
+        motions[i] = (motion && !frames[i].motion) ? Image() : getFrameImage(motion, frames[i].motion);
+      }
+
+      // The stages access the buffers concurrently, so these must be allocated
+      // before starting the pipeline
+      net->allocScratch();
+      if (!initialized)
+        init();
+
+      // The scratch tensors may have been re-allocated since the last execution
+      updateSwapTensor(inputSwap);
+      updateSwapTensor(outputSwap);
+
+      // The network must access its own buffers after the sequence, even if
+      // it fails
+      try
+      {
+        executeFrames(colors, albedos, normals, outputs, motions, progressFunc, progressUserPtr);
+      }
+      catch (...)
+      {
+        restoreBuffers();
+        throw;
+      }
+      restoreBuffers();
+    }
+
+    void releaseScratch() override
+    {
+      // The buffers of the pipeline are scratch tensors of the network
+      net->releaseScratch();
+    }
+
+    size_t getScratchByteSize(bool residentOnly) const override
+    {
+      return 0;
+    }
+
+  private:
+    void executeFrames(const std::vector<Image>& colors,
+                       const std::vector<Image>& albedos,
+                       const std::vector<Image>& normals,
+                       const std::vector<Image>& outputs,
+                       const std::vector<Image>& motions,
+                       ProgressMonitorFunction progressFunc, void* progressUserPtr)
+    {
+      const size_t numFrames = colors.size();
+
+      // The progress is reported only by the network stage, thus the progress
+      // monitor function is never called concurrently
+      const size_t netBegin = 1, netEnd = net->getNumNodes() - 1; // skip the original input and output reorders
+      Progress progress(device.get(), progressFunc, progressUserPtr, numFrames * net->getWorkAmount(netBegin, netEnd));
+
+      auto inputStage = [&](size_t i)
+      {
+        const auto& transferFunc = transferFuncs[i % numTransferFuncs];
+        const auto& inputReorder = inputReorders[i % numBuffers];
+        inputReorder->setSrc(colors[i], albedos[i], normals[i]);
+        inputReorder->setTransferFunc(transferFunc);
+        inputReorder->execute();
+      };
+
+      auto networkStage = [&](size_t i)
+      {
+        // Point the network to the input and output buffers of the frame
+        net->setScratchData(inputSwap.owner,  inputSwap.data[i % numBuffers]);
+        net->setScratchData(outputSwap.owner, outputSwap.data[i % numBuffers]);
+        net->execute(netBegin, netEnd, &progress);
+      };
+
+      auto outputStage = [&](size_t i)
+      {
+        const auto& outputReorder = outputReorders[i % numBuffers];
+        outputReorder->setDst(outputs[i]);
+        outputReorder->setTransferFunc(transferFuncs[i % numTransferFuncs]);
+        outputReorder->execute();
+
+        if (temporal)
+          temporal->execute(outputs[i], motions[i]);
+      };
+
+      // Prologue
+      device->executeTask([&]() { inputStage(0); });
+
+      for (size_t i = 0; i < numFrames; ++i)
+      {
+        if (device->getNumIOThreads() == 0)
+        {
+          // There are no threads reserved for the I/O stages (e.g. everything
+          // is executed on the caller thread), so the stages are executed
+          // sequentially
+          device->executeTask([&]()
+          {
+            networkStage(i);
+            if (i + 1 < numFrames)
+              inputStage(i + 1);
+            if (i > 0)
+              outputStage(i - 1);
+          });
+          continue;
+        }
+
+        // Process the input of the next frame and the output of the previous
+        // frame in the I/O thread
+        const bool hasIO = i + 1 < numFrames || i > 0;
+        if (hasIO)
+        {
+          ioThread.run([&, i]()
+          {
+            device->executeIOTask([&]()
+            {
+              if (i + 1 < numFrames)
+                inputStage(i + 1);
+              if (i > 0)
+                outputStage(i - 1);
+            });
+          });
+        }
+
+        // Execute the network on the current frame
+        try
+        {
+          device->executePipelineTask([&]() { networkStage(i); });
+        }
+        catch (...)
+        {
+          if (hasIO)
+          {
+            try { ioThread.wait(); } catch (...) {} // report the error of the network stage
+          }
+          throw;
+        }
+
+        if (hasIO)
+          ioThread.wait();
+      }
+
+      // Epilogue
+      device->executeTask([&]() { outputStage(numFrames - 1); });
+      progress.finish();
+    }
+
+    void init()
+    {
+      initSwapTensor(inputSwap, netInput);
+      initSwapTensor(outputSwap, netOutput);
+
+      for (int i = 0; i < numBuffers; ++i)
+      {
+        inputReorders[i] = std::make_shared<InputReorderNode<K, TransferFunc>>(color, albedo, normal, inputSwap.views[i], transferFuncs[0], analyzer);
+        outputReorders[i] = std::make_shared<OutputReorderNode<K, TransferFunc>>(outputSwap.views[i], output, transferFuncs[0]);
+      }
+
+      initialized = true;
+    }
+
+    void initSwapTensor(SwapTensor& t, const std::shared_ptr<memory>& tensor)
+    {
+      t.owner = net->getScratchOwner(tensor, t.byteOffset);
+      t.buffer = net->allocTensor(getTensorDims(t.owner));
+      for (int i = 0; i < numBuffers; ++i)
+        t.views[i] = std::make_shared<memory>(tensor->get_primitive_desc(), tensor->get_data_handle());
+      updateSwapTensor(t);
+    }
+
+    void updateSwapTensor(SwapTensor& t)
+    {
+      t.data[0] = (char*)t.owner->get_data_handle();
+      t.data[1] = (char*)t.buffer->get_data_handle();
+      for (int i = 0; i < numBuffers; ++i)
+        t.views[i]->set_data_handle(t.data[i] + t.byteOffset);
+    }
+
+    void restoreBuffers()
+    {
+      net->setScratchData(inputSwap.owner,  inputSwap.data[0]);
+      net->setScratchData(outputSwap.owner, outputSwap.data[0]);
+    }
+  };
+
+  // Executes a network on batches of frames in a weight-stationary fashion
+  // Each node is executed on all frames of the batch before moving on to the
+  // next node, so the weights of a layer are loaded into the cache only once
+  // per batch. Every frame of the batch is processed by a separate copy of
+  // the network (lane), which shares the weights with the original network
+  // but has its own tensors, thus the batch size bounds the memory usage. The
+  // first lane is the original network itself.
+  template<int K, class TransferFunc>
+  class BatchPipelineImpl : public SequencePipeline
+  {
+  public:
+    // Builds a new network with the specified transfer function, which shares
+    // the weights with the original network
+    typedef std::function<std::shared_ptr<Network<K>>(const std::shared_ptr<TransferFunc>&)> BuildFunction;
+
+  private:
+    struct Lane
+    {
+      std::shared_ptr<Network<K>> net;
+      std::shared_ptr<TransferFunc> transferFunc;
+      std::shared_ptr<InputReorderNode<K, TransferFunc>> inputReorder;
+      std::shared_ptr<OutputReorderNode<K, TransferFunc>> outputReorder;
+    };
+
+    Ref<Device> device;
+    BuildFunction buildFunc;
+    int maxBatchSize;
+
+    // The images of the frames must have the same layout as these
+    Image color;
+    Image albedo;
+    Image normal;
+    Image output;
+    Image motion;
+
+    std::shared_ptr<TemporalNode> temporal; // blends the outputs with the history (optional)
+
+    std::vector<Lane> lanes; // the first lane is the original network, the others are allocated on first use
+
+  public:
+    BatchPipelineImpl(const Ref<Device>& device,
+                      const std::shared_ptr<Network<K>>& net,
+                      const std::shared_ptr<TransferFunc>& transferFunc,
+                      const BuildFunction& buildFunc,
+                      int maxBatchSize,
+                      const Image& color,
+                      const Image& albedo,
+                      const Image& normal,
+                      const Image& output,
+                      const Image& motion,
+                      const std::shared_ptr<TemporalNode>& temporal)
+      : device(device), buildFunc(buildFunc), maxBatchSize(maxBatchSize),
+        color(color), albedo(albedo), normal(normal), output(output), motion(motion),
+        temporal(temporal)
+    {
+      assert(maxBatchSize >= 1);
+      lanes.push_back(initLane(net, transferFunc));
+    }
+
+    void execute(const Frame* frames, size_t numFrames,
+                 ProgressMonitorFunction progressFunc, void* progressUserPtr) override
+    {
+      if (numFrames == 0)
+        return;
+
+      // Get the images of all frames first to catch any errors before execution
+      std::vector<Image> colors(numFrames), albedos(numFrames), normals(numFrames), outputs(numFrames), motions(numFrames);
+      for (size_t i = 0; i < numFrames; ++i)
+      {
+        colors[i]  = getFrameImage(color,  frames[i].color);
+        albedos[i] = getFrameImage(albedo, frames[i].albedo);
+        normals[i] = getFrameImage(normal, frames[i].normal);
+        outputs[i] = getFrameImage(output, frames[i].output);
+        motions[i] = (motion && !frames[i].motion) ? Image() : getFrameImage(motion, frames[i].motion);
+      }
+
+      // The first lane is the original network, so its images must be
+      // restored after the sequence, even if it fails
+      try
+      {
+        device->executeTask([&]()
+        {
+          executeBatches(colors, albedos, normals, outputs, motions, progressFunc, progressUserPtr);
+        });
+      }
+      catch (...)
+      {
+        restoreImages();
+        throw;
+      }
+      restoreImages();
+    }
+
+    // The first lane is managed by the owner of the original network
+    void releaseScratch() override
+    {
+      for (size_t i = 1; i < lanes.size(); ++i)
+        lanes[i].net->releaseScratch();
+    }
+
+    size_t getScratchByteSize(bool residentOnly) const override
+    {
+      size_t byteSize = 0;
+      for (size_t i = 1; i < lanes.size(); ++i)
+        byteSize += lanes[i].net->getScratchByteSize(residentOnly);
+      return byteSize;
+    }
+
+  private:
+    void executeBatches(const std::vector<Image>& colors,
+                        const std::vector<Image>& albedos,
+                        const std::vector<Image>& normals,
+                        const std::vector<Image>& outputs,
+                        const std::vector<Image>& motions,
+                        ProgressMonitorFunction progressFunc, void* progressUserPtr)
+    {
+      const size_t numFrames = colors.size();
+
+      // Allocate only as many lanes as needed
+      const size_t numLanes = min(numFrames, size_t(maxBatchSize));
+      while (lanes.size() < numLanes)
+      {
+        auto laneTransferFunc = std::make_shared<TransferFunc>();
+        lanes.push_back(initLane(buildFunc(laneTransferFunc), laneTransferFunc));
+      }
+
+      const auto& net = lanes[0].net;
+      const size_t numNodes = net->getNumNodes();
+      Progress progress(device.get(), progressFunc, progressUserPtr, numFrames * net->getWorkAmount());
+
+      for (size_t batchBegin = 0; batchBegin < numFrames; batchBegin += numLanes)
+      {
+        const size_t batchSize = min(numFrames - batchBegin, numLanes);
+
+        for (size_t j = 0; j < batchSize; ++j)
+        {
+          const size_t i = batchBegin + j;
+          lanes[j].inputReorder->setSrc(colors[i], albedos[i], normals[i]);
+          lanes[j].outputReorder->setDst(outputs[i]);
+        }
+
+        // The frames must be processed in order by the input reorders, which
+        // may depend on the previous frames (e.g. exposure smoothing)
+        for (size_t k = 0; k < numNodes; ++k)
+        {
+          for (size_t j = 0; j < batchSize; ++j)
+            lanes[j].net->execute(k, k+1, &progress);
+        }
+
+        // The temporal blending depends on the previous frame
+        if (temporal)
+        {
+          for (size_t j = 0; j < batchSize; ++j)
+          {
+            const size_t i = batchBegin + j;
+            temporal->execute(outputs[i], motions[i]);
+          }
+        }
+      }
+
+      progress.finish();
+    }
+
+    void restoreImages()
+    {
+      lanes[0].inputReorder->setSrc(color, albedo, normal);
+      lanes[0].outputReorder->setDst(output);
+    }
+
+    Lane initLane(const std::shared_ptr<Network<K>>& net, const std::shared_ptr<TransferFunc>& transferFunc)
+    {
+      Lane lane;
+      lane.net = net;
+      lane.transferFunc = transferFunc;
+
+      // The first and last nodes of the network are the input and output reorders
+      lane.inputReorder  = std::dynamic_pointer_cast<InputReorderNode<K, TransferFunc>>(lane.net->getNode(0));
+      lane.outputReorder = std::dynamic_pointer_cast<OutputReorderNode<K, TransferFunc>>(lane.net->getNode(lane.net->getNumNodes() - 1));
+      if (!lane.inputReorder || !lane.outputReorder)
+        throw Exception(Error::InvalidOperation, "invalid network for batched execution");
+      return lane;
+    }
+  };
+
+} // namespace oidn
@@ -0,0 +1,188 @@
+// ======================================================================== //
+// Copyright 2009-2019 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "node.h"
+#include "image.h"
+
+namespace oidn {
+
+  // Temporal accumulation node
+  // Blends the denoised image with the reprojected output of the previous
+  // frame, which is clamped to the neighborhood of the pixel in the current
+  // image to avoid ghosting. The output image is updated in place, and the
+  // history is double-buffered.
+  class TemporalNode : public Node
+  {
+  private:
+    Image filterOutput; // output image of the filter, replaced by the blended image
+    Image filterMotion; // motion image of the filter
+    Image history[2]; // blended images of the previous and the current frame
+    int current = 0;  // index of the history of the previous frame
+    bool valid = false;
+    float blend;      // weight of the history
+
+  public:
+    TemporalNode(const Image& output,
+                 const Image& motion,
+                 const Image& history0,
+                 const Image& history1,
+                 float blend)
+      : filterOutput(output),
+        filterMotion(motion),
+        blend(blend)
+    {
+      assert(output.format == Format::Float3);
+      assert(motion.format == Format::Float2);
+      history[0] = history0;
+      history[1] = history1;
+    }
+
+    // Blends the images of the filter
+    void execute() override
+    {
+      execute(filterOutput, filterMotion);
+    }
+
+    // Blends the images of a frame of a sequence, which must have the same
+    // dimensions as the images of the filter
+    // The output is the denoised image of the frame, and the motion image
+    // contains the screen-space motion vectors in pixels from the current to
+    // the previous frame (may be null).
+    void execute(const Image& output, const Image& motion)
+    {
+      assert(output.width == filterOutput.width && output.height == filterOutput.height);
+
+      const int H = output.height;
+      const int W = output.width;
+
+      // Without history or motion vectors, only the history is updated
+      if (!valid || !motion)
+      {
+        parallel_nd(H, [&](int h)
+        {
+          for (int w = 0; w < W; ++w)
+            copyPixel((float*)history[current].get(h, w), (const float*)output.get(h, w));
+        });
+        valid = true;
+        return;
+      }
+
+      const Image& prev = history[current];
+      const Image& next = history[1-current];
+
+      parallel_nd(H, [&](int h)
+      {
+        for (int w = 0; w < W; ++w)
+        {
+          const float* color = (const float*)output.get(h, w);
+          float* result = (float*)next.get(h, w);
+
+          // Reproject the pixel to the previous frame
+          const float* m = (const float*)motion.get(h, w);
+          const float x = float(w) + m[0];
+          const float y = float(h) + m[1];
+
+          // Disoccluded pixels and NaN motion vectors are not blended
+          if (!(x >= 0.f && x <= float(W-1) && y >= 0.f && y <= float(H-1)))
+          {
+            copyPixel(result, color);
+            continue;
+          }
+
+          // Clamp the history to the 3x3 neighborhood of the current pixel
+          float minColor[3] = { color[0], color[1], color[2] };
+          float maxColor[3] = { color[0], color[1], color[2] };
+          for (int j = max(h-1, 0); j <= min(h+1, H-1); ++j)
+          {
+            for (int i = max(w-1, 0); i <= min(w+1, W-1); ++i)
+            {
+              const float* c = (const float*)output.get(j, i);
+              for (int k = 0; k < 3; ++k)
+              {
+                minColor[k] = min(minColor[k], c[k]);
+                maxColor[k] = max(maxColor[k], c[k]);
+              }
+            }
+          }
+
+          float hist[3];
+          sampleBilinear(prev, x, y, hist);
+          for (int k = 0; k < 3; ++k)
+          {
+            const float c = clamp(hist[k], minColor[k], maxColor[k]);
+            result[k] = color[k] + (c - color[k]) * blend;
+          }
+        }
+      });
+
+      // Copy the blended image to the output
+      parallel_nd(H, [&](int h)
+      {
+        for (int w = 0; w < W; ++w)
+          copyPixel((float*)output.get(h, w), (const float*)next.get(h, w));
+      });
+
+      current = 1 - current;
+    }
+
+    void setBlend(float blend) { this->blend = blend; }
+
+    // Discards the history, so the next frame is not blended
+    void reset() { valid = false; }
+
+    // Returns the size of the history buffers
+    size_t getByteSize() const
+    {
+      size_t byteSize = 0;
+      for (const auto& image : history)
+        byteSize += image.buffer ? image.buffer->size() : 0;
+      return byteSize;
+    }
+
+  private:
+    static __forceinline void copyPixel(float* dst, const float* src)
+    {
+      dst[0] = src[0];
+      dst[1] = src[1];
+      dst[2] = src[2];
+    }
+
+    static __forceinline void sampleBilinear(const Image& image, float x, float y, float* result)
+    {
+      const int x0 = min(int(x), image.width  - 1);
+      const int y0 = min(int(y), image.height - 1);
+      const int x1 = min(x0 + 1, image.width  - 1);
+      const int y1 = min(y0 + 1, image.height - 1);
+      const float tx = x - float(x0);
+      const float ty = y - float(y0);
+
+      const float* p00 = (const float*)image.get(y0, x0);
+      const float* p01 = (const float*)image.get(y0, x1);
+      const float* p10 = (const float*)image.get(y1, x0);
+      const float* p11 = (const float*)image.get(y1, x1);
+
+      for (int k = 0; k < 3; ++k)
+      {
+        const float v0 = p00[k] + (p01[k] - p00[k]) * tx;
+        const float v1 = p10[k] + (p11[k] - p10[k]) * tx;
+        result[k] = v0 + (v1 - v0) * ty;
+      }
+    }
+  };
+
+} // namespace oidn
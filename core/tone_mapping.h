@@ -17,6 +17,7 @@
 #pragma once
 
 #include "image.h"
+#include <emmintrin.h>
 
 namespace oidn {
 
@@ -25,6 +26,25 @@ namespace oidn {
     return 0.212671f * r + 0.715160f * g + 0.072169f * b;
   }
 
+  // Returns the sum of the luminances of n RGB pixels stored with a stride
+  // of at least 4 floats (e.g. in a blocked tensor), using SSE
+  // The value following the RGB channels of each pixel is ignored.
+  __forceinline float luminanceSum(const float* rgb, int n, int stride)
+  {
+    const __m128 mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    const __m128 weights = _mm_setr_ps(0.212671f, 0.715160f, 0.072169f, 0.f);
+
+    __m128 sum = _mm_setzero_ps();
+    for (int i = 0; i < n; ++i, rgb += stride)
+      sum = _mm_add_ps(sum, _mm_and_ps(_mm_loadu_ps(rgb), mask));
+
+    // Apply the weights once to the sums of the channels
+    sum = _mm_mul_ps(sum, weights);
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+  }
+
   // Color transfer function
   class TransferFunc
   {
@@ -89,6 +109,23 @@ namespace oidn {
     }
   };
 
-  float autoexposure(const Image& color);
+  // Automatic exposure: the luminance is averaged in blocks to minimize
+  // sensitivity to noise, and the exposure maps the average log luminance of
+  // the blocks to the key value
+  constexpr int autoexposureBlockSize = 16;
+  constexpr float autoexposureKey = 0.18f;
+  constexpr float autoexposureEps = 1e-8f; // blocks with lower luminance are ignored
+
+  // Returns the number of blocks in a dimension for autoexposure
+  __forceinline int getAutoexposureNumBlocks(int size)
+  {
+    return (size + autoexposureBlockSize/2) / autoexposureBlockSize;
+  }
+
+  // Returns the exposure from the sum of the log2 luminances of the blocks
+  __forceinline float getAutoexposure(float logLuminanceSum, int numBlocks)
+  {
+    return (numBlocks > 0) ? (autoexposureKey / exp2(logLuminanceSum / float(numBlocks))) : 1.f;
+  }
 
 } // namespace oidn
@@ -21,6 +21,7 @@
 namespace oidn {
 
   // 2x2 nearest-neighbor upsampling node
+  // The destination may be cropped by one row/column (for odd sizes).
   template<int K>
   class UpsampleNode : public Node
   {
@@ -48,32 +49,37 @@ namespace oidn {
       assert(dstDesc.data_type == memory::data_type::f32);
       assert(srcDesc.dims[0] == 1);
       assert(dstDesc.dims[0] == 1);
-      // 2x2 upsampling
-      assert(dstDesc.dims[2] == srcDesc.dims[2] * 2);
-      assert(dstDesc.dims[3] == srcDesc.dims[3] * 2);
+      // 2x2 upsampling, optionally cropped
+      assert(dstDesc.dims[2] <= srcDesc.dims[2] * 2 && dstDesc.dims[2] >= srcDesc.dims[2] * 2 - 1);
+      assert(dstDesc.dims[3] <= srcDesc.dims[3] * 2 && dstDesc.dims[3] >= srcDesc.dims[3] * 2 - 1);
     }
 
     void execute() override
     {
       memory::primitive_desc srcPrimDesc = src->get_primitive_desc();
+      memory::primitive_desc dstPrimDesc = dst->get_primitive_desc();
       const mkldnn_memory_desc_t& srcDesc = srcPrimDesc.desc().data;
+      const mkldnn_memory_desc_t& dstDesc = dstPrimDesc.desc().data;
 
       const float* srcPtr = (float*)src->get_data_handle();
       float* dstPtr = (float*)dst->get_data_handle();
 
-      const int C = srcDesc.dims[1];
-      const int H = srcDesc.dims[2];
-      const int W = srcDesc.dims[3];
+      const int C  = srcDesc.dims[1];
+      const int H  = srcDesc.dims[2];
+      const int W  = srcDesc.dims[3];
+      const int H2 = dstDesc.dims[2];
+      const int W2 = dstDesc.dims[3];
       const int CK = C / K;
 
       parallel_nd(CK, H, [&](int ck, int h)
       {
-        const size_t offset = ck*H*W*K + h*W*K;
-        const float* srcPtr_line = srcPtr + offset;
-        float* dstPtr_line0 = dstPtr + offset * 4;
-        float* dstPtr_line1 = dstPtr_line0 + W*2*K; // next line
+        const float* srcPtr_line = srcPtr + (size_t(ck)*H + h) * W*K;
+        float* dstPtr_line0 = dstPtr + (size_t(ck)*H2 + h*2) * W2*K;
+        float* dstPtr_line1 = dstPtr_line0 + W2*K; // next line
+        const bool hasLine1 = h*2+1 < H2;
 
-        for (int w = 0; w < W; ++w)
+        // Full 2x2 blocks
+        for (int w = 0; w < W2/2; ++w)
         {
           #pragma unroll
           for (int k = 0; k < K; k += 4)
@@ -82,8 +88,27 @@ namespace oidn {
 
             _mm_stream_ps(&dstPtr_line0[w*2*K   + k], m);
             _mm_stream_ps(&dstPtr_line0[w*2*K+K + k], m);
-            _mm_stream_ps(&dstPtr_line1[w*2*K   + k], m);
-            _mm_stream_ps(&dstPtr_line1[w*2*K+K + k], m);
+            if (hasLine1)
+            {
+              _mm_stream_ps(&dstPtr_line1[w*2*K   + k], m);
+              _mm_stream_ps(&dstPtr_line1[w*2*K+K + k], m);
+            }
+          }
+        }
+
+        // Cropped last column
+        if (W2 % 2)
+        {
+          const int w = W2/2;
+
+          #pragma unroll
+          for (int k = 0; k < K; k += 4)
+          {
+            const __m128 m = _mm_load_ps(&srcPtr_line[w*K + k]);
+
+            _mm_stream_ps(&dstPtr_line0[w*2*K + k], m);
+            if (hasLine1)
+              _mm_stream_ps(&dstPtr_line1[w*2*K + k], m);
           }
         }
       });
@@ -0,0 +1,137 @@
+// ======================================================================== //
+// Copyright 2009-2019 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include "node.h"
+#include "winograd_avx2.h"
+
+namespace oidn {
+
+  // 3x3 convolution node using the Winograd F(4x4, 3x3) algorithm (AVX2)
+  // Supports only the nChw8c format, for which MKL-DNN has no Winograd implementation
+  class WinogradConvNode : public Node
+  {
+  private:
+    std::shared_ptr<memory> src;
+    std::shared_ptr<memory> bias;
+    std::shared_ptr<memory> dst;
+    std::shared_ptr<float> weights; // transformed weights
+    double workAmount;
+    std::vector<float> scratch;     // per-thread scratch memory
+    bool relu;
+
+  public:
+    WinogradConvNode(const std::shared_ptr<memory>& src,
+                     const std::shared_ptr<memory>& weightsPad,
+                     const std::shared_ptr<memory>& bias,
+                     const std::shared_ptr<memory>& dst,
+                     bool relu)
+      : src(src),
+        bias(bias),
+        dst(dst),
+        relu(relu)
+    {
+      memory::primitive_desc srcPrimDesc = src->get_primitive_desc();
+      memory::primitive_desc dstPrimDesc = dst->get_primitive_desc();
+      memory::primitive_desc weightsPrimDesc = weightsPad->get_primitive_desc();
+      const mkldnn_memory_desc_t& srcDesc = srcPrimDesc.desc().data;
+      const mkldnn_memory_desc_t& dstDesc = dstPrimDesc.desc().data;
+      const mkldnn_memory_desc_t& weightsDesc = weightsPrimDesc.desc().data;
+      MAYBE_UNUSED(srcDesc);
+      MAYBE_UNUSED(dstDesc);
+      assert(srcDesc.format == memory::format::nChw8c);
+      assert(dstDesc.format == memory::format::nChw8c);
+      assert(weightsDesc.format == memory::format::oihw);
+      assert(srcDesc.dims[0] == 1);
+      assert(dstDesc.dims[0] == 1);
+      assert(srcDesc.dims[1] == weightsDesc.dims[1]); // IC
+      assert(dstDesc.dims[1] == weightsDesc.dims[0]); // OC
+      assert(srcDesc.dims[2] == dstDesc.dims[2]);     // H
+      assert(srcDesc.dims[3] == dstDesc.dims[3]);     // W
+      assert(weightsDesc.dims[2] == 3 && weightsDesc.dims[3] == 3);
+
+      // Transform the weights to the Winograd domain
+      const int OC = weightsDesc.dims[0];
+      const int IC = weightsDesc.dims[1];
+      weights = std::shared_ptr<float>((float*)alignedMalloc(getWinogradWeightsSize(OC, IC) * sizeof(float), 64), alignedFree);
+      transformWinogradWeights((const float*)weightsPad->get_data_handle(), weights.get(), OC, IC);
+
+      workAmount = getConvWorkAmount(weightsPad, dst);
+    }
+
+    // Creates a convolution with the same weights but different tensors
+    WinogradConvNode(const WinogradConvNode& other,
+                     const std::shared_ptr<memory>& src,
+                     const std::shared_ptr<memory>& dst)
+      : src(src),
+        bias(other.bias),
+        dst(dst),
+        weights(other.weights),
+        workAmount(getConv3x3WorkAmount(src, dst)), // the spatial size may differ
+        relu(other.relu)
+    {
+      assert(getTensorDims(src)[1] == getTensorDims(other.src)[1]); // IC
+      assert(getTensorDims(dst)[1] == getTensorDims(other.dst)[1]); // OC
+      assert(getTensorDims(src)[2] == getTensorDims(dst)[2]); // H
+      assert(getTensorDims(src)[3] == getTensorDims(dst)[3]); // W
+    }
+
+    void execute() override
+    {
+      memory::primitive_desc srcPrimDesc = src->get_primitive_desc();
+      memory::primitive_desc dstPrimDesc = dst->get_primitive_desc();
+      const mkldnn_memory_desc_t& srcDesc = srcPrimDesc.desc().data;
+      const mkldnn_memory_desc_t& dstDesc = dstPrimDesc.desc().data;
+
+      WinogradConvParams p;
+      p.src     = (const float*)src->get_data_handle();
+      p.weights = weights.get();
+      p.bias    = (const float*)bias->get_data_handle();
+      p.dst     = (float*)dst->get_data_handle();
+      p.IC      = srcDesc.dims[1];
+      p.OC      = dstDesc.dims[1];
+      p.H       = srcDesc.dims[2];
+      p.W       = srcDesc.dims[3];
+      p.relu    = relu;
+
+      // Split the rows of tiles into chunks for better load balancing
+      const int numTileRows  = (p.H + winogradTileSize - 1) / winogradTileSize;
+      const int numTileCols  = (p.W + winogradTileSize - 1) / winogradTileSize;
+      const int chunkSize    = winogradRowTiles * 2;
+      const int numChunks    = (numTileCols + chunkSize - 1) / chunkSize;
+
+      // Allocate the scratch memory for each thread
+      const int numThreads = tbb::this_task_arena::max_concurrency();
+      const size_t scratchSize = getPadded<16>(int(getWinogradScratchSize(p.IC))); // avoid false sharing
+      if (scratch.size() < numThreads * scratchSize + 16)
+        scratch.resize(numThreads * scratchSize + 16);
+      float* scratchPtr = (float*)(((uintptr_t)scratch.data() + 63) & ~uintptr_t(63));
+
+      parallel_nd(numTileRows, numChunks, [&](int tileRow, int chunk)
+      {
+        const int threadIndex = tbb::this_task_arena::current_thread_index();
+        const int tileBegin = chunk * chunkSize;
+        const int tileEnd   = min(tileBegin + chunkSize, numTileCols);
+        executeWinogradConv(p, tileRow, tileBegin, tileEnd, scratchPtr + threadIndex * scratchSize);
+      });
+    }
+
+    std::shared_ptr<memory> getDst() const override { return dst; }
+    double getWorkAmount() const override { return workAmount; }
+  };
+
+} // namespace oidn
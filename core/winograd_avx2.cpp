@@ -0,0 +1,303 @@
+// ======================================================================== //
+// Copyright 2009-2019 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+// Winograd F(4x4, 3x3) convolution kernels for AVX2
+// This file must be compiled with AVX2 and FMA enabled, and it must *not*
+// include any common headers (see winograd_avx2.h).
+
+#include <immintrin.h>
+#include "winograd_avx2.h"
+
+namespace oidn {
+
+  namespace
+  {
+    constexpr int alpha = winogradAlpha;
+    constexpr int m = winogradTileSize;
+    constexpr int B = winogradBlockSize;
+    constexpr int T = winogradRowTiles;
+
+    // Computes B^T * d for a column of 6 values
+    inline void transformInput(const __m256 d[alpha], __m256 r[alpha])
+    {
+      const __m256 c2 = _mm256_set1_ps(2.f);
+      const __m256 c4 = _mm256_set1_ps(4.f);
+      const __m256 c5 = _mm256_set1_ps(5.f);
+
+      const __m256 s12 = _mm256_add_ps(d[1], d[2]);
+      const __m256 s34 = _mm256_add_ps(d[3], d[4]);
+      const __m256 d12 = _mm256_sub_ps(d[1], d[2]);
+      const __m256 d34 = _mm256_sub_ps(d[3], d[4]);
+      const __m256 d31 = _mm256_sub_ps(d[3], d[1]);
+      const __m256 d42 = _mm256_sub_ps(d[4], d[2]);
+
+      r[0] = _mm256_fmadd_ps(c4, d[0], _mm256_fnmadd_ps(c5, d[2], d[4]));
+      r[1] = _mm256_fnmadd_ps(c4, s12, s34);
+      r[2] = _mm256_fmsub_ps(c4, d12, d34);
+      r[3] = _mm256_fmadd_ps(c2, d31, d42);
+      r[4] = _mm256_fnmadd_ps(c2, d31, d42);
+      r[5] = _mm256_fmadd_ps(c4, d[1], _mm256_fnmadd_ps(c5, d[3], d[5]));
+    }
+
+    // Computes A^T * x for a column of 6 values
+    inline void transformOutput(const __m256 x[alpha], __m256 r[m])
+    {
+      const __m256 c2 = _mm256_set1_ps(2.f);
+      const __m256 c4 = _mm256_set1_ps(4.f);
+      const __m256 c8 = _mm256_set1_ps(8.f);
+
+      const __m256 s12 = _mm256_add_ps(x[1], x[2]);
+      const __m256 s34 = _mm256_add_ps(x[3], x[4]);
+      const __m256 d12 = _mm256_sub_ps(x[1], x[2]);
+      const __m256 d34 = _mm256_sub_ps(x[3], x[4]);
+
+      r[0] = _mm256_add_ps(_mm256_add_ps(x[0], s12), s34);
+      r[1] = _mm256_fmadd_ps(c2, d34, d12);
+      r[2] = _mm256_fmadd_ps(c4, s34, s12);
+      r[3] = _mm256_add_ps(_mm256_fmadd_ps(c8, d34, d12), x[5]);
+    }
+
+    // Transforms an input tile of one channel block to the Winograd domain
+    // The transformed values are stored with a stride of T*B floats
+    inline void transformInputTile(const WinogradConvParams& p, const float* srcPtr,
+                                               int y0, int x0, float* V, size_t strideV)
+    {
+      __m256 d[alpha][alpha];
+
+      if (y0 >= 0 && x0 >= 0 && y0 + alpha <= p.H && x0 + alpha <= p.W)
+      {
+        // Interior tile
+        for (int i = 0; i < alpha; ++i)
+          for (int j = 0; j < alpha; ++j)
+            d[i][j] = _mm256_load_ps(srcPtr + (size_t(y0+i) * p.W + (x0+j)) * B);
+      }
+      else
+      {
+        // Border tile, zero padding
+        for (int i = 0; i < alpha; ++i)
+        {
+          const int y = y0 + i;
+          for (int j = 0; j < alpha; ++j)
+          {
+            const int x = x0 + j;
+            if (y >= 0 && y < p.H && x >= 0 && x < p.W)
+              d[i][j] = _mm256_load_ps(srcPtr + (size_t(y) * p.W + x) * B);
+            else
+              d[i][j] = _mm256_setzero_ps();
+          }
+        }
+      }
+
+      // Transform the columns
+      __m256 t[alpha][alpha];
+      for (int j = 0; j < alpha; ++j)
+      {
+        __m256 col[alpha], res[alpha];
+        for (int i = 0; i < alpha; ++i)
+          col[i] = d[i][j];
+        transformInput(col, res);
+        for (int i = 0; i < alpha; ++i)
+          t[i][j] = res[i];
+      }
+
+      // Transform the rows
+      for (int i = 0; i < alpha; ++i)
+      {
+        __m256 res[alpha];
+        transformInput(t[i], res);
+        for (int j = 0; j < alpha; ++j)
+          _mm256_store_ps(V + (i*alpha + j) * strideV, res[j]);
+      }
+    }
+
+    // Transforms an output tile of one channel block back from the Winograd
+    // domain, applies the bias and relu, and stores the valid pixels
+    inline void transformOutputTile(const WinogradConvParams& p, const float* M,
+                                                __m256 bias, float* dstPtr, int y0, int x0)
+    {
+      // Transform the columns
+      __m256 t[m][alpha];
+      for (int j = 0; j < alpha; ++j)
+      {
+        __m256 col[alpha], res[m];
+        for (int i = 0; i < alpha; ++i)
+          col[i] = _mm256_load_ps(M + (i*alpha + j) * (T*B));
+        transformOutput(col, res);
+        for (int i = 0; i < m; ++i)
+          t[i][j] = res[i];
+      }
+
+      // Transform the rows and store
+      const __m256 zero = _mm256_setzero_ps();
+      for (int i = 0; i < m; ++i)
+      {
+        const int y = y0 + i;
+        if (y >= p.H)
+          break;
+
+        __m256 res[m];
+        transformOutput(t[i], res);
+
+        for (int j = 0; j < m; ++j)
+        {
+          const int x = x0 + j;
+          if (x >= p.W)
+            break;
+
+          __m256 value = _mm256_add_ps(res[j], bias);
+          if (p.relu)
+            value = _mm256_max_ps(value, zero);
+          _mm256_store_ps(dstPtr + (size_t(y) * p.W + x) * B, value);
+        }
+      }
+    }
+  }
+
+  size_t getWinogradWeightsSize(int OC, int IC)
+  {
+    return size_t(alpha*alpha) * OC * IC;
+  }
+
+  size_t getWinogradScratchSize(int IC)
+  {
+    // Transformed input tiles + transformed output tiles
+    return size_t(alpha*alpha) * IC * T + size_t(alpha*alpha) * T * B;
+  }
+
+  void transformWinogradWeights(const float* src, float* dst, int OC, int IC)
+  {
+    // G matrix of F(4x4, 3x3)
+    const float G[alpha][3] =
+    {
+      { 1.f/4,   0.f,     0.f    },
+      {-1.f/6,  -1.f/6,  -1.f/6  },
+      {-1.f/6,   1.f/6,  -1.f/6  },
+      { 1.f/24,  1.f/12,  1.f/6  },
+      { 1.f/24, -1.f/12,  1.f/6  },
+      { 0.f,     0.f,     1.f    }
+    };
+
+    for (int oc = 0; oc < OC; ++oc)
+    {
+      for (int ic = 0; ic < IC; ++ic)
+      {
+        // Source is in oihw format
+        const float* g = src + (size_t(oc) * IC + ic) * 9;
+
+        // Compute G * g
+        float Gg[alpha][3];
+        for (int i = 0; i < alpha; ++i)
+          for (int j = 0; j < 3; ++j)
+            Gg[i][j] = G[i][0] * g[0*3+j] + G[i][1] * g[1*3+j] + G[i][2] * g[2*3+j];
+
+        // Compute (G * g) * G^T
+        for (int i = 0; i < alpha; ++i)
+        {
+          for (int j = 0; j < alpha; ++j)
+          {
+            const float u = Gg[i][0] * G[j][0] + Gg[i][1] * G[j][1] + Gg[i][2] * G[j][2];
+
+            // Destination is in [OC/B][alpha*alpha][IC][B] format
+            const int xi = i*alpha + j;
+            dst[((size_t(oc/B) * (alpha*alpha) + xi) * IC + ic) * B + (oc%B)] = u;
+          }
+        }
+      }
+    }
+  }
+
+  void executeWinogradConv(const WinogradConvParams& p,
+                           int tileRow, int tileBegin, int tileEnd,
+                           float* scratch)
+  {
+    const int ICB = p.IC / B;
+    const int OCB = p.OC / B;
+    const size_t planeSize = size_t(p.H) * p.W * B;
+
+    // Scratch layout: V[alpha*alpha][ICB][T][B], M[alpha*alpha][T][B]
+    float* V = scratch;
+    float* M = scratch + size_t(alpha*alpha) * p.IC * T;
+    const size_t strideV = size_t(ICB) * T * B;
+
+    const int y0 = tileRow * m;
+
+    for (int tile0 = tileBegin; tile0 < tileEnd; tile0 += T)
+    {
+      const int numTiles = (tileEnd - tile0 < T) ? (tileEnd - tile0) : T;
+
+      // Transform the input tiles
+      for (int icb = 0; icb < ICB; ++icb)
+      {
+        const float* srcPtr = p.src + icb * planeSize;
+
+        for (int t = 0; t < T; ++t)
+        {
+          float* Vt = V + (size_t(icb) * T + t) * B;
+
+          if (t < numTiles)
+          {
+            transformInputTile(p, srcPtr, y0 - 1, (tile0 + t) * m - 1, Vt, strideV);
+          }
+          else
+          {
+            // Clear the unused tiles
+            for (int xi = 0; xi < alpha*alpha; ++xi)
+              _mm256_store_ps(Vt + xi * strideV, _mm256_setzero_ps());
+          }
+        }
+      }
+
+      for (int ocb = 0; ocb < OCB; ++ocb)
+      {
+        // Batched matrix multiplication in the Winograd domain
+        const float* U = p.weights + size_t(ocb) * (alpha*alpha) * p.IC * B;
+
+        for (int xi = 0; xi < alpha*alpha; ++xi)
+        {
+          __m256 acc[T];
+          for (int t = 0; t < T; ++t)
+            acc[t] = _mm256_setzero_ps();
+
+          const float* Uxi = U + size_t(xi) * p.IC * B;
+          const float* Vxi = V + xi * strideV;
+
+          for (int icb = 0; icb < ICB; ++icb)
+          {
+            for (int c = 0; c < B; ++c)
+            {
+              const __m256 w = _mm256_load_ps(Uxi + (icb*B + c) * B);
+              const float* v = Vxi + icb * (T*B) + c;
+
+              for (int t = 0; t < T; ++t)
+                acc[t] = _mm256_fmadd_ps(w, _mm256_broadcast_ss(v + t*B), acc[t]);
+            }
+          }
+
+          for (int t = 0; t < T; ++t)
+            _mm256_store_ps(M + (xi*T + t) * B, acc[t]);
+        }
+
+        // Transform the output tiles
+        const __m256 bias = _mm256_loadu_ps(p.bias + ocb*B);
+        float* dstPtr = p.dst + ocb * planeSize;
+
+        for (int t = 0; t < numTiles; ++t)
+          transformOutputTile(p, M + t*B, bias, dstPtr, y0, (tile0 + t) * m);
+      }
+    }
+  }
+
+} // namespace oidn
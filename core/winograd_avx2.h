@@ -0,0 +1,62 @@
+// ======================================================================== //
+// Copyright 2009-2019 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#pragma once
+
+#include <cstddef>
+
+// This header is included by a translation unit compiled for AVX2, so it must
+// not pull in any code which could be shared with other translation units
+// (e.g. inline functions, templates).
+
+namespace oidn {
+
+  // Parameters of a Winograd F(4x4, 3x3) convolution with 1x1 zero padding
+  // All tensors are in nChw8c format and the channels are padded to 8
+  struct WinogradConvParams
+  {
+    const float* src;     // source tensor
+    const float* weights; // weights transformed with transformWinogradWeights
+    const float* bias;    // biases (OC)
+    float* dst;           // destination tensor
+    int IC;               // number of input channels
+    int OC;               // number of output channels
+    int H;                // height of the source and destination
+    int W;                // width of the source and destination
+    bool relu;            // apply relu after adding the biases
+  };
+
+  // Winograd F(4x4, 3x3) constants
+  constexpr int winogradTileSize  = 4; // output tile size
+  constexpr int winogradAlpha     = 6; // input tile size
+  constexpr int winogradBlockSize = 8; // channel block size
+  constexpr int winogradRowTiles  = 8; // number of tiles processed together
+
+  // Returns the number of values in the transformed weights
+  size_t getWinogradWeightsSize(int OC, int IC);
+
+  // Returns the number of values in the per-thread scratch memory
+  size_t getWinogradScratchSize(int IC);
+
+  // Transforms padded oihw 3x3 weights to the Winograd domain
+  void transformWinogradWeights(const float* src, float* dst, int OC, int IC);
+
+  // Computes the output tiles [tileBegin, tileEnd) in a row of tiles
+  void executeWinogradConv(const WinogradConvParams& p,
+                           int tileRow, int tileBegin, int tileEnd,
+                           float* scratch);
+
+} // namespace oidn
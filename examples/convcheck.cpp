@@ -0,0 +1,223 @@
+// ======================================================================== //
+// Copyright 2009-2019 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <random>
+#include <OpenImageDenoise/oidn.hpp>
+
+#include "image_io.h"
+#include "cli.h"
+
+using namespace oidn;
+
+// Compares the outputs of the filter with Winograd and direct convolutions,
+// which must match within a tolerance
+
+void printUsage()
+{
+  std::cout << "Open Image Denoise Convolution Check" << std::endl;
+  std::cout << "Usage: convcheck [-ldr ldr_color] [-srgb] [-hdr hdr_color]" << std::endl
+            << "                 [-alb albedo] [-nrm normal] [-size width height]" << std::endl
+            << "                 [-tol tolerance] [-threads n] [-builtin 0|1]" << std::endl
+            << "Without an input image, a random HDR image is generated (with a fixed seed)." << std::endl;
+}
+
+void errorCallback(void* userPtr, Error error, const char* message)
+{
+  throw std::runtime_error(message);
+}
+
+// Generates a random HDR image with smooth gradients and noise
+Tensor makeRandomImage(int width, int height, float maxValue, unsigned int seed)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> noise(0.f, 1.f);
+
+  Tensor image({height, width, 3}, "hwc");
+  for (int h = 0; h < height; ++h)
+  {
+    for (int w = 0; w < width; ++w)
+    {
+      for (int c = 0; c < 3; ++c)
+      {
+        const float gradient = float(w + h * (c+1)) / float(width + height * 3);
+        image.data[(size_t(h) * width + w) * 3 + c] = maxValue * gradient * noise(rng);
+      }
+    }
+  }
+  return image;
+}
+
+Tensor denoise(DeviceRef& device, ConvAlgo convAlgo,
+               const Tensor& color, const Tensor& albedo, const Tensor& normal,
+               bool hdr, bool srgb)
+{
+  const int height = color.dims[0];
+  const int width  = color.dims[1];
+  Tensor output({height, width, 3}, "hwc");
+
+  FilterRef filter = device.newFilter("RT");
+  filter.setImage("color", color.data, Format::Float3, width, height);
+  if (albedo)
+    filter.setImage("albedo", albedo.data, Format::Float3, width, height);
+  if (normal)
+    filter.setImage("normal", normal.data, Format::Float3, width, height);
+  filter.setImage("output", output.data, Format::Float3, width, height);
+  filter.set("hdr", hdr);
+  filter.set("srgb", srgb);
+  filter.set("convAlgo", int(convAlgo));
+  filter.commit();
+  filter.execute();
+  return output;
+}
+
+// Returns the maximum error of the output, which is relative for values
+// greater than 1 (HDR) and absolute otherwise
+float getMaxError(const Tensor& output, const Tensor& ref)
+{
+  float maxErr = 0;
+  for (size_t i = 0; i < output.size(); ++i)
+  {
+    const float err = std::abs(output.data[i] - ref.data[i]) / std::max(std::abs(ref.data[i]), 1.f);
+    if (!(err <= maxErr))
+      maxErr = err; // also catches NaNs
+  }
+  return maxErr;
+}
+
+int main(int argc, char* argv[])
+{
+  std::string colorFilename, albedoFilename, normalFilename;
+  bool hdr = true;
+  bool srgb = false;
+  std::vector<std::pair<int, int>> sizes;
+  float tolerance = 1e-3f;
+  int numThreads = -1;
+  int builtinKernels = -1;
+
+  try
+  {
+    ArgParser args(argc, argv);
+    while (args.hasNext())
+    {
+      std::string opt = args.getNextOpt();
+      if (opt == "ldr")
+      {
+        colorFilename = args.getNextValue();
+        hdr = false;
+      }
+      else if (opt == "hdr")
+      {
+        colorFilename = args.getNextValue();
+        hdr = true;
+      }
+      else if (opt == "srgb")
+        srgb = true;
+      else if (opt == "alb" || opt == "albedo")
+        albedoFilename = args.getNextValue();
+      else if (opt == "nrm" || opt == "normal")
+        normalFilename = args.getNextValue();
+      else if (opt == "size")
+      {
+        const int width  = args.getNextValueInt();
+        const int height = args.getNextValueInt();
+        if (width <= 0 || height <= 0)
+          throw std::invalid_argument("invalid image size");
+        sizes.push_back(std::make_pair(width, height));
+      }
+      else if (opt == "tol" || opt == "tolerance")
+        tolerance = float(atof(args.getNextValue().c_str()));
+      else if (opt == "threads")
+        numThreads = args.getNextValueInt();
+      else if (opt == "builtin")
+        builtinKernels = args.getNextValueInt();
+      else if (opt == "h" || opt == "help")
+      {
+        printUsage();
+        return 1;
+      }
+      else
+        throw std::invalid_argument("invalid argument");
+    }
+
+    // By default, check sizes which are multiples of the tile size of the
+    // Winograd convolutions and sizes which are not
+    if (sizes.empty() && colorFilename.empty())
+      sizes = {{64, 64}, {131, 67}, {320, 241}};
+
+    DeviceRef device = newDevice();
+
+    const char* errorMessage;
+    if (device.getError(errorMessage) != Error::None)
+      throw std::runtime_error(errorMessage);
+    device.setErrorFunction(errorCallback);
+
+    if (numThreads > 0)
+      device.set("numThreads", numThreads);
+    if (builtinKernels >= 0)
+      device.set("builtinKernels", bool(builtinKernels));
+    device.commit();
+
+    int numFailed = 0;
+    const size_t numImages = colorFilename.empty() ? sizes.size() : 1;
+
+    for (size_t i = 0; i < numImages; ++i)
+    {
+      Tensor color, albedo, normal;
+
+      if (!colorFilename.empty())
+      {
+        color = loadImage(colorFilename);
+        if (!albedoFilename.empty())
+          albedo = loadImage(albedoFilename);
+        if (!normalFilename.empty())
+          normal = loadImage(normalFilename);
+      }
+      else
+        color = makeRandomImage(sizes[i].first, sizes[i].second, hdr ? 10.f : 1.f, unsigned(i));
+
+      const int height = color.dims[0];
+      const int width  = color.dims[1];
+
+      const Tensor direct   = denoise(device, ConvAlgo::Direct,   color, albedo, normal, hdr, srgb);
+      const Tensor winograd = denoise(device, ConvAlgo::Winograd, color, albedo, normal, hdr, srgb);
+
+      const float maxErr = getMaxError(winograd, direct);
+      const bool passed = maxErr <= tolerance;
+      if (!passed)
+        ++numFailed;
+
+      std::cout << width << "x" << height << ": maxerr=" << maxErr
+                << (passed ? " passed" : " FAILED") << std::endl;
+    }
+
+    if (numFailed > 0)
+    {
+      std::cout << "Winograd and direct convolutions differ by more than " << tolerance << std::endl;
+      return 1;
+    }
+  }
+  catch (std::exception& e)
+  {
+    std::cout << std::endl << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -35,6 +35,9 @@ void printUsage()
   std::cout << "Open Image Denoise Example" << std::endl;
   std::cout << "Usage: denoise [-ldr ldr_color] [-srgb] [-hdr hdr_color]" << std::endl
             << "               [-alb albedo] [-nrm normal]" << std::endl
+#ifdef HAS_OPEN_EXR
+            << "               [-exr multilayer_hdr_color_albedo_normal.exr]" << std::endl
+#endif
             << "               [-o output] [-ref reference_output]" << std::endl
             << "               [-bench ntimes] [-threads n] [-affinity 0|1]" << std::endl;
 }
@@ -47,6 +50,7 @@ void errorCallback(void* userPtr, Error error, const char* message)
 int main(int argc, char* argv[])
 {
   std::string colorFilename, albedoFilename, normalFilename;
+  std::string layersFilename;
   std::string outputFilename, refFilename;
   bool hdr = false;
   bool srgb = false;
@@ -77,6 +81,13 @@ int main(int argc, char* argv[])
         colorFilename = args.getNextValue();
         hdr = true;
       }
+#ifdef HAS_OPEN_EXR
+      else if (opt == "exr")
+      {
+        layersFilename = args.getNextValue();
+        hdr = true;
+      }
+#endif
       else if (opt == "srgb")
         srgb = true;
       else if (opt == "alb" || opt == "albedo")
@@ -102,7 +113,7 @@ int main(int argc, char* argv[])
         throw std::invalid_argument("invalid argument");
     }
 
-    if (colorFilename.empty())
+    if (colorFilename.empty() && layersFilename.empty())
       throw std::runtime_error("no color image specified");
 
     // Load the input image
@@ -111,7 +122,21 @@ int main(int argc, char* argv[])
 
     std::cout << "Loading input" << std::flush;
 
-    color = loadImage(colorFilename);
+#ifdef HAS_OPEN_EXR
+    if (!layersFilename.empty())
+    {
+      // Load the color (default layer), albedo and normal from a single multi-layer file
+      std::vector<Tensor> layers = loadImageLayersEXR(layersFilename, {"", "albedo", "normal"});
+      color  = layers[0];
+      albedo = layers[1];
+      normal = layers[2];
+      if (!color)
+        throw std::runtime_error("no color channels found in '" + layersFilename + "'");
+    }
+    else
+#endif
+      color = loadImage(colorFilename);
+
     if (!albedoFilename.empty())
       albedo = loadImage(albedoFilename);
     if (!normalFilename.empty())
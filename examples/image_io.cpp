@@ -24,33 +24,86 @@
 #include <OpenEXR/ImfChannelList.h>
 #include <OpenEXR/ImfInputFile.h>
 #include <OpenEXR/ImfOutputFile.h>
+#include <OpenEXR/ImfThreading.h>
+#include <mutex>
+#include <thread>
 #endif
 
 namespace oidn {
 
 #ifdef HAS_OPEN_EXR
-  Imf::FrameBuffer frameBufferForEXR(const Tensor& image)
+  // Enables the OpenEXR thread pool for decoding and encoding the pixels
+  void initThreadsEXR()
   {
+    static std::once_flag flag;
+    std::call_once(flag, []() { Imf::setGlobalThreadCount(int(std::thread::hardware_concurrency())); });
+  }
+
+  // Finds the names of the 3 channels of a layer (e.g. "albedo.R", "albedo.G", "albedo.B")
+  // The channels of the unnamed layer have no prefix.
+  bool findLayerChannelsEXR(const Imf::ChannelList& channels, const std::string& layer, std::string names[3])
+  {
+    static const char* suffixes[][3] = {{"R", "G", "B"}, {"r", "g", "b"}, {"X", "Y", "Z"}, {"x", "y", "z"}};
+    const std::string prefix = layer.empty() ? "" : layer + ".";
+
+    for (const auto& suffix : suffixes)
+    {
+      int c = 0;
+      for (; c < 3; ++c)
+      {
+        names[c] = prefix + suffix[c];
+        if (!channels.findChannel(names[c]))
+          break;
+      }
+      if (c == 3)
+        return true;
+    }
+    return false;
+  }
+
+  // Inserts the slices of an image into a frame buffer, taking the origin of the data window into account
+  void insertSlicesEXR(Imf::FrameBuffer& frameBuffer, const Tensor& image, const Imath::Box2i& dataWindow, const std::string names[3])
+  {
+    const size_t xStride = image.dims[2]*sizeof(float);
+    const size_t yStride = image.dims[1]*image.dims[2]*sizeof(float);
+    char* base = (char*)image.data - dataWindow.min.x*xStride - dataWindow.min.y*yStride;
+    for (int c = 0; c < 3; ++c)
+      frameBuffer.insert(names[c], Imf::Slice(Imf::FLOAT, base + c*sizeof(float), xStride, yStride));
+  }
+
+  std::vector<Tensor> loadImageLayersEXR(const std::string& filename, const std::vector<std::string>& layers)
+  {
+    initThreadsEXR();
+    Imf::InputFile inputFile(filename.c_str(), Imf::globalThreadCount());
+    const Imf::ChannelList& channels = inputFile.header().channels();
+    const Imath::Box2i dataWindow = inputFile.header().dataWindow();
+    const int H = dataWindow.max.y - dataWindow.min.y + 1;
+    const int W = dataWindow.max.x - dataWindow.min.x + 1;
+
+    // Read all layers in a single pass
     Imf::FrameBuffer frameBuffer;
-    int xStride = image.dims[2]*sizeof(float);
-    int yStride = image.dims[1]*image.dims[2]*sizeof(float);
-    frameBuffer.insert("R", Imf::Slice(Imf::FLOAT, (char*)&image[0], xStride, yStride));
-    frameBuffer.insert("G", Imf::Slice(Imf::FLOAT, (char*)&image[1], xStride, yStride));
-    frameBuffer.insert("B", Imf::Slice(Imf::FLOAT, (char*)&image[2], xStride, yStride));
-    return frameBuffer;
+    std::vector<Tensor> images(layers.size());
+
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+      std::string names[3];
+      if (!findLayerChannelsEXR(channels, layers[i], names))
+        continue;
+
+      images[i] = Tensor({H, W, 3}, "hwc");
+      insertSlicesEXR(frameBuffer, images[i], dataWindow, names);
+    }
+
+    inputFile.setFrameBuffer(frameBuffer);
+    inputFile.readPixels(dataWindow.min.y, dataWindow.max.y);
+    return images;
   }
 
   Tensor loadImageEXR(const std::string& filename)
   {
-    Imf::InputFile inputFile(filename.c_str());
-    if (!inputFile.header().channels().findChannel("R") ||
-        !inputFile.header().channels().findChannel("G") ||
-        !inputFile.header().channels().findChannel("B"))
+    Tensor image = loadImageLayersEXR(filename, {""})[0];
+    if (!image)
       throw std::invalid_argument("image must have 3 channels");
-    Imath::Box2i dataWindow = inputFile.header().dataWindow();
-    Tensor image({dataWindow.max.y-dataWindow.min.y+1, dataWindow.max.x-dataWindow.min.x+1, 3}, "hwc");
-    inputFile.setFrameBuffer(frameBufferForEXR(image));
-    inputFile.readPixels(dataWindow.min.y, dataWindow.max.y);
     return image;
   }
 
@@ -58,12 +111,15 @@ namespace oidn {
   {
     if (image.ndims() != 3 || image.dims[2] != 3 || image.format != "hwc")
       throw std::invalid_argument("image must have 3 channels");
+    initThreadsEXR();
     Imf::Header header(image.dims[1], image.dims[0], 1, Imath::V2f(0, 0), image.dims[1], Imf::INCREASING_Y, Imf::ZIP_COMPRESSION);
-    header.channels().insert("R", Imf::Channel(Imf::FLOAT));
-    header.channels().insert("G", Imf::Channel(Imf::FLOAT));
-    header.channels().insert("B", Imf::Channel(Imf::FLOAT));
-    Imf::OutputFile outputFile(filename.c_str(), header);
-    outputFile.setFrameBuffer(frameBufferForEXR(image));
+    const std::string names[3] = {"R", "G", "B"};
+    for (int c = 0; c < 3; ++c)
+      header.channels().insert(names[c], Imf::Channel(Imf::FLOAT));
+    Imf::OutputFile outputFile(filename.c_str(), header, Imf::globalThreadCount());
+    Imf::FrameBuffer frameBuffer;
+    insertSlicesEXR(frameBuffer, image, header.dataWindow(), names);
+    outputFile.setFrameBuffer(frameBuffer);
     outputFile.writePixels(image.dims[0]);
   }
 #endif
@@ -101,19 +157,17 @@ namespace oidn {
       throw std::runtime_error("big-endian PFM images are not supported");
     scale = fabs(scale);
 
-    // Read the pixels
+    // Read the pixels directly into the image, one row at a time (stored bottom-to-top)
     Tensor image({H, W, C}, "hwc");
 
     for (int h = 0; h < H; ++h)
     {
-      for (int w = 0; w < W; ++w)
+      float* row = &image[size_t(H-1-h)*W*C];
+      file.read((char*)row, size_t(W)*C*sizeof(float));
+      if (scale != 1.f)
       {
-        for (int c = 0; c < C; ++c)
-        {
-          float x;
-          file.read((char*)&x, sizeof(float));
-          image[((H-1-h)*W + w) * C + c] = x * scale;
-        }
+        for (int i = 0; i < W*C; ++i)
+          row[i] *= scale;
       }
     }
 
@@ -141,18 +195,9 @@ namespace oidn {
     file << W << " " << H << std::endl;
     file << "-1.0" << std::endl;
 
-    // Write the pixels
+    // Write the pixels, one row at a time (stored bottom-to-top)
     for (int h = 0; h < H; ++h)
-    {
-      for (int w = 0; w < W; ++w)
-      {
-        for (int c = 0; c < 3; ++c)
-        {
-          const float x = image[((H-1-h)*W + w) * C + c];
-          file.write((char*)&x, sizeof(float));
-        }
-      }
-    }
+      file.write((const char*)&image[size_t(H-1-h)*W*C], size_t(W)*C*sizeof(float));
   }
 
   void saveImagePPM(const Tensor& image, const std::string& filename)
@@ -217,6 +262,8 @@ namespace oidn {
     else
 #endif
     if (format == "pfm")
+      saveImagePFM(image, filename);
+    else if (format == "ppm")
       saveImagePPM(image, filename);
     else
       throw std::invalid_argument("image format is not supported");
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include "common/tensor.h"
 
 namespace oidn {
@@ -25,6 +26,11 @@ namespace oidn {
   // Loads an image from an EXR file
   Tensor loadImageEXR(const std::string& filename);
 
+  // Loads the RGB (or XYZ) channels of multiple layers (e.g. "" for the default
+  // layer, "albedo", "normal") from an EXR file in a single pass
+  // The images of the layers which are not found are empty.
+  std::vector<Tensor> loadImageLayersEXR(const std::string& filename, const std::vector<std::string>& layers);
+
   // Saves an image to an EXR file
   void saveImageEXR(const Tensor& image, const std::string& filename);
 #endif
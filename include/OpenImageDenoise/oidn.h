@@ -55,8 +55,25 @@ typedef enum
   OIDN_ERROR_INVALID_OPERATION    = 3, // the operation is not allowed
   OIDN_ERROR_OUT_OF_MEMORY        = 4, // not enough memory to execute the operation
   OIDN_ERROR_UNSUPPORTED_HARDWARE = 5, // the hardware (e.g. CPU) is not supported
+  OIDN_ERROR_CANCELLED            = 6, // the operation was cancelled by the user
 } OIDNError;
 
+// Policies for exceeding the memory budget of a device
+typedef enum
+{
+  OIDN_MEMORY_POLICY_FAIL = 0, // fail with an out of memory error
+  OIDN_MEMORY_POLICY_TRIM = 1, // trim the least recently executed idle filters, then fail
+  OIDN_MEMORY_POLICY_WAIT = 2, // trim idle filters, and wait until enough memory is released
+} OIDNMemoryPolicy;
+
+// Convolution algorithms of the filters
+typedef enum
+{
+  OIDN_CONV_ALGO_AUTO     = 0, // select the fastest supported algorithm
+  OIDN_CONV_ALGO_DIRECT   = 1, // direct convolution
+  OIDN_CONV_ALGO_WINOGRAD = 2, // Winograd convolution (if supported, otherwise direct)
+} OIDNConvAlgo;
+
 // Error callback function
 typedef void (*OIDNErrorFunction)(void* userPtr, OIDNError code, const char* message);
 
@@ -93,10 +110,22 @@ OIDN_API void oidnSetDeviceErrorFunction(OIDNDevice device, OIDNErrorFunction fu
 // device creation failed.
 OIDN_API OIDNError oidnGetDeviceError(OIDNDevice device, const char** outMessage);
 
+// Selects the fastest thread configuration of the device (number of threads,
+// SMT usage and pinning) by timing a synthetic workload with the candidate
+// configurations, and stores it in the autotuning cache of the machine.
+// Must be called before committing the device, and the result is applied when
+// committing it.
+OIDN_API void oidnAutotuneDevice(OIDNDevice device);
+
 // Commits all previous changes to the device.
 // Must be called before first using the device (e.g. creating filters).
 OIDN_API void oidnCommitDevice(OIDNDevice device);
 
+// Releases the memory of the filters of the device which is re-allocated on
+// their next execution (e.g. intermediate buffers), keeping the weights.
+// Filters which are currently executing are not affected.
+OIDN_API void oidnTrimDevice(OIDNDevice device);
+
 // ----------------------------------------------------------------------------
 // Buffer
 // ----------------------------------------------------------------------------
@@ -131,6 +160,13 @@ OIDN_API OIDNBuffer oidnNewBuffer(OIDNDevice device, size_t byteSize);
 // Creates a new shared buffer (data allocated and owned by the user).
 OIDN_API OIDNBuffer oidnNewSharedBuffer(OIDNDevice device, void* ptr, size_t byteSize);
 
+// Creates a new buffer for an image with the specified format and size, with
+// padding and alignment chosen by the device for optimal performance.
+// The pixel and row strides of the image are returned if the pointers are not NULL.
+OIDN_API OIDNBuffer oidnNewImageBuffer(OIDNDevice device, OIDNFormat format,
+                                       size_t width, size_t height,
+                                       size_t* bytePixelStride, size_t* byteRowStride);
+
 // Maps a region of the buffer to host memory.
 // If byteSize is 0, the maximum available amount of memory will be mapped.
 OIDN_API void* oidnMapBuffer(OIDNBuffer buffer, OIDNAccess access, size_t byteOffset, size_t byteSize);
@@ -152,6 +188,42 @@ OIDN_API void oidnReleaseBuffer(OIDNBuffer buffer);
 // Filter handle
 typedef struct OIDNFilterImpl* OIDNFilter;
 
+// Images of a frame in a sequence
+typedef struct
+{
+  void* color;  // color image
+  void* albedo; // albedo image (NULL if not used)
+  void* normal; // normal image (NULL if not used)
+  void* output; // output image
+  void* motion; // motion vectors (NULL if not used or not available)
+} OIDNFrame;
+
+// Estimated cost of a layer of a filter
+typedef struct
+{
+  char name[32];   // name of the layer
+  double flops;    // number of floating-point operations
+  double bytes;    // number of bytes read and written (tensors, images and weights)
+  size_t byteSize; // size of the output tensor in bytes
+  double time;     // estimated execution time in seconds
+} OIDNLayerCost;
+
+// Descriptor of an internal tensor of a filter, stored in blocked layout:
+// element (c, h, w) is at index ((c / blockSize) * height * width + h * width + w) * blockSize + c % blockSize
+typedef struct
+{
+  int numChannels; // number of channels containing data
+  int channels;    // number of channels including the padding (multiple of blockSize)
+  int height;      // height in pixels
+  int width;       // width in pixels
+  int blockSize;   // number of channels stored interleaved per pixel
+  size_t byteSize; // size of the tensor in bytes (32-bit floats)
+} OIDNTensorDesc;
+
+// Progress monitor callback function
+// Returns false if the operation should be cancelled.
+typedef bool (*OIDNProgressMonitorFunction)(void* userPtr, double n);
+
 // Creates a new filter of the specified type (e.g. "RT").
 OIDN_API OIDNFilter oidnNewFilter(OIDNDevice device, const char* type);
 
@@ -183,19 +255,52 @@ OIDN_API void oidnSetFilter1b(OIDNFilter filter, const char* name, bool value);
 // Sets an integer parameter of the filter.
 OIDN_API void oidnSetFilter1i(OIDNFilter filter, const char* name, int value);
 
+// Sets a float parameter of the filter.
+OIDN_API void oidnSetFilter1f(OIDNFilter filter, const char* name, float value);
+
 // Gets a boolean parameter of the filter.
 OIDN_API bool oidnGetFilter1b(OIDNFilter filter, const char* name);
 
 // Gets an integer parameter of the filter.
 OIDN_API int oidnGetFilter1i(OIDNFilter filter, const char* name);
 
+// Gets a float parameter of the filter.
+OIDN_API float oidnGetFilter1f(OIDNFilter filter, const char* name);
+
+// Sets the progress monitor callback function of the filter.
+OIDN_API void oidnSetFilterProgressMonitorFunction(OIDNFilter filter, OIDNProgressMonitorFunction func, void* userPtr);
+
 // Commits all previous changes to the filter.
 // Must be called before first executing the filter.
 OIDN_API void oidnCommitFilter(OIDNFilter filter);
 
+// Estimates the cost of executing the filter with its current parameters on
+// images with the specified size and features, using numThreads threads
+// (0 for the number of threads of the device). A short calibration is run on
+// the device when this is called for the first time.
+// Returns the number of layers, and stores the costs of at most maxLayers
+// layers in the layers array (can be NULL). The total estimated execution
+// time in seconds and memory usage in bytes are also returned if the pointers
+// are not NULL.
+OIDN_API size_t oidnEstimateFilterCost(OIDNFilter filter,
+                                       size_t width, size_t height,
+                                       bool albedo, bool normal, int numThreads,
+                                       OIDNLayerCost* layers, size_t maxLayers,
+                                       double* time, size_t* memoryByteSize);
+
 // Executes the filter.
 OIDN_API void oidnExecuteFilter(OIDNFilter filter);
 
+// Executes the filter on a sequence of frames, overlapping the processing of
+// consecutive frames. The images of each frame must have the same format,
+// dimensions and strides as the images set for the filter.
+OIDN_API void oidnExecuteFilterSequence(OIDNFilter filter, const OIDNFrame* frames, size_t numFrames);
+
+// Returns a pointer to an internal tensor of a committed filter (e.g. "input"
+// or "output"), and stores its descriptor if the pointer is not NULL. The
+// pointer is valid until the filter is committed again or released.
+OIDN_API void* oidnGetFilterTensor(OIDNFilter filter, const char* name, OIDNTensorDesc* desc);
+
 #if defined(__cplusplus)
 }
 #endif
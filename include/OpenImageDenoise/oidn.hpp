@@ -131,6 +131,19 @@ namespace oidn {
   // Filter
   // --------------------------------------------------------------------------
 
+  // Images of a frame in a sequence
+  typedef OIDNFrame Frame;
+
+  // Estimated cost of a layer of a filter
+  typedef OIDNLayerCost LayerCost;
+
+  // Descriptor of an internal tensor of a filter
+  typedef OIDNTensorDesc TensorDesc;
+
+  // Progress monitor callback function
+  // Returns false if the operation should be cancelled.
+  typedef bool (*ProgressMonitorFunction)(void* userPtr, double n);
+
   // Filter object with automatic reference counting
   class FilterRef
   {
@@ -237,21 +250,59 @@ namespace oidn {
       oidnSetFilter1i(handle, name, value);
     }
 
+    // Sets a float parameter of the filter.
+    void set(const char* name, float value)
+    {
+      oidnSetFilter1f(handle, name, value);
+    }
+
     // Gets a parameter of the filter.
     template<typename T>
     T get(const char* name);
 
+    // Sets the progress monitor callback function of the filter.
+    void setProgressMonitorFunction(ProgressMonitorFunction func, void* userPtr = nullptr)
+    {
+      oidnSetFilterProgressMonitorFunction(handle, (OIDNProgressMonitorFunction)func, userPtr);
+    }
+
     // Commits all previous changes to the filter.
     void commit()
     {
       oidnCommitFilter(handle);
     }
 
+    // Estimates the cost of executing the filter with its current parameters on
+    // images with the specified size and features, using numThreads threads
+    // (0 for the number of threads of the device).
+    // Returns the number of layers, and stores the costs of at most maxLayers layers.
+    size_t estimateCost(size_t width, size_t height, bool albedo, bool normal, int numThreads,
+                        LayerCost* layers, size_t maxLayers,
+                        double* time = nullptr, size_t* memoryByteSize = nullptr)
+    {
+      return oidnEstimateFilterCost(handle, width, height, albedo, normal, numThreads,
+                                    layers, maxLayers, time, memoryByteSize);
+    }
+
     // Executes the filter.
     void execute()
     {
       oidnExecuteFilter(handle);
     }
+
+    // Executes the filter on a sequence of frames.
+    void executeSequence(const Frame* frames, size_t numFrames)
+    {
+      oidnExecuteFilterSequence(handle, frames, numFrames);
+    }
+
+    // Returns a pointer to an internal tensor of the committed filter (e.g.
+    // "input" or "output"), and stores its descriptor if the pointer is not
+    // null. The pointer is valid until the filter is committed again or released.
+    void* getTensor(const char* name, TensorDesc* desc = nullptr)
+    {
+      return oidnGetFilterTensor(handle, name, desc);
+    }
   };
 
   // Gets a boolean parameter of the filter.
@@ -268,6 +319,13 @@ namespace oidn {
     return oidnGetFilter1i(handle, name);
   }
 
+  // Gets a float parameter of the filter.
+  template<>
+  inline float FilterRef::get(const char* name)
+  {
+    return oidnGetFilter1f(handle, name);
+  }
+
   // --------------------------------------------------------------------------
   // Device
   // --------------------------------------------------------------------------
@@ -289,6 +347,23 @@ namespace oidn {
     InvalidOperation    = OIDN_ERROR_INVALID_OPERATION,    // the operation is not allowed
     OutOfMemory         = OIDN_ERROR_OUT_OF_MEMORY,        // not enough memory to execute the operation
     UnsupportedHardware = OIDN_ERROR_UNSUPPORTED_HARDWARE, // the hardware (e.g. CPU) is not supported
+    Cancelled           = OIDN_ERROR_CANCELLED,            // the operation was cancelled by the user
+  };
+
+  // Policies for exceeding the memory budget of a device
+  enum class MemoryPolicy
+  {
+    Fail = OIDN_MEMORY_POLICY_FAIL, // fail with an out of memory error
+    Trim = OIDN_MEMORY_POLICY_TRIM, // trim the least recently executed idle filters, then fail
+    Wait = OIDN_MEMORY_POLICY_WAIT, // trim idle filters, and wait until enough memory is released
+  };
+
+  // Convolution algorithms of the filters
+  enum class ConvAlgo
+  {
+    Auto     = OIDN_CONV_ALGO_AUTO,     // select the fastest supported algorithm
+    Direct   = OIDN_CONV_ALGO_DIRECT,   // direct convolution
+    Winograd = OIDN_CONV_ALGO_WINOGRAD, // Winograd convolution (if supported, otherwise direct)
   };
 
   // Error callback function
@@ -396,6 +471,14 @@ namespace oidn {
       return (Error)oidnGetDeviceError(handle, &outMessage);
     }
 
+    // Selects the fastest thread configuration of the device by timing a
+    // synthetic workload, and stores it in the autotuning cache of the machine.
+    // Must be called before committing the device.
+    void autotune()
+    {
+      oidnAutotuneDevice(handle);
+    }
+
     // Commits all previous changes to the device.
     // Must be called before first using the device (e.g. creating filters).
     void commit()
@@ -403,6 +486,14 @@ namespace oidn {
       oidnCommitDevice(handle);
     }
 
+    // Releases the memory of the filters of the device which is re-allocated
+    // on their next execution (e.g. intermediate buffers), keeping the weights.
+    // Filters which are currently executing are not affected.
+    void trim()
+    {
+      oidnTrimDevice(handle);
+    }
+
     // Creates a new buffer (data allocated and owned by the device).
     BufferRef newBuffer(size_t byteSize)
     {
@@ -415,6 +506,15 @@ namespace oidn {
       return oidnNewSharedBuffer(handle, ptr, byteSize);
     }
 
+    // Creates a new buffer for an image with the specified format and size,
+    // with padding and alignment chosen by the device for optimal performance.
+    // The pixel and row strides of the image are returned if the pointers are not null.
+    BufferRef newImageBuffer(Format format, size_t width, size_t height,
+                             size_t* bytePixelStride = nullptr, size_t* byteRowStride = nullptr)
+    {
+      return oidnNewImageBuffer(handle, (OIDNFormat)format, width, height, bytePixelStride, byteRowStride);
+    }
+
     // Creates a new filter of the specified type (e.g. "RT").
     FilterRef newFilter(const char* type)
     {
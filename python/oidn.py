@@ -0,0 +1,434 @@
+## ======================================================================== ##
+## Copyright 2009-2019 Intel Corporation                                    ##
+##                                                                          ##
+## Licensed under the Apache License, Version 2.0 (the "License");          ##
+## you may not use this file except in compliance with the License.         ##
+## You may obtain a copy of the License at                                  ##
+##                                                                          ##
+##     http://www.apache.org/licenses/LICENSE-2.0                           ##
+##                                                                          ##
+## Unless required by applicable law or agreed to in writing, software      ##
+## distributed under the License is distributed on an "AS IS" BASIS,        ##
+## WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. ##
+## See the License for the specific language governing permissions and      ##
+## limitations under the License.                                           ##
+## ======================================================================== ##
+
+# Python bindings for the Open Image Denoise C API
+#
+# Images are passed as objects supporting the buffer protocol (e.g. NumPy
+# arrays) with shape (height, width, channels), float32 elements and at least 3
+# channels. The images are shared with the library without copying, so strided
+# views (e.g. crops, RGB channels of RGBA images, padded rows) can be used
+# directly. The GIL is released while the library is running (ctypes releases
+# it for every foreign call), so other Python threads can run concurrently.
+
+import os
+import sys
+import ctypes
+import ctypes.util
+
+__all__ = ['Error', 'Device', 'Filter', 'denoise',
+           'DEVICE_TYPE_DEFAULT', 'DEVICE_TYPE_CPU',
+           'FORMAT_FLOAT2', 'FORMAT_FLOAT3']
+
+DEVICE_TYPE_DEFAULT = 0
+DEVICE_TYPE_CPU     = 1
+
+FORMAT_FLOAT2 = 2
+FORMAT_FLOAT3 = 3
+
+_ERROR_NAMES = {
+  1: 'unknown error',
+  2: 'invalid argument',
+  3: 'invalid operation',
+  4: 'out of memory',
+  5: 'unsupported hardware',
+  6: 'cancelled'
+}
+
+# ----------------------------------------------------------------------------
+# Library
+# ----------------------------------------------------------------------------
+
+def _load_library():
+  if sys.platform == 'win32':
+    name = 'OpenImageDenoise.dll'
+  elif sys.platform == 'darwin':
+    name = 'libOpenImageDenoise.dylib'
+  else:
+    name = 'libOpenImageDenoise.so'
+
+  # Search the path in OIDN_LIBRARY, the directory of this module and its
+  # parent (e.g. lib/python/oidn.py next to lib/libOpenImageDenoise.so)
+  paths = []
+  if 'OIDN_LIBRARY' in os.environ:
+    paths.append(os.environ['OIDN_LIBRARY'])
+  module_dir = os.path.dirname(os.path.abspath(__file__))
+  paths.append(os.path.join(module_dir, name))
+  paths.append(os.path.join(os.path.dirname(module_dir), name))
+  found = ctypes.util.find_library('OpenImageDenoise')
+  if found:
+    paths.append(found)
+
+  for path in paths:
+    if os.path.isabs(path) and not os.path.exists(path):
+      continue
+    try:
+      # CDLL releases the GIL during the calls
+      return ctypes.CDLL(path)
+    except OSError:
+      pass
+  raise ImportError('could not load the Open Image Denoise library (set OIDN_LIBRARY to its path)')
+
+_lib = _load_library()
+
+_c_void_p = ctypes.c_void_p
+_c_char_p = ctypes.c_char_p
+_c_size_t = ctypes.c_size_t
+
+_ProgressMonitorFunction = ctypes.CFUNCTYPE(ctypes.c_bool, ctypes.c_void_p, ctypes.c_double)
+
+class _Frame(ctypes.Structure):
+  _fields_ = [('color',  _c_void_p),
+              ('albedo', _c_void_p),
+              ('normal', _c_void_p),
+              ('output', _c_void_p),
+              ('motion', _c_void_p)]
+
+def _declare(name, restype, *argtypes):
+  func = getattr(_lib, name)
+  func.restype = restype
+  func.argtypes = argtypes
+
+_declare('oidnNewDevice',          _c_void_p, ctypes.c_int)
+_declare('oidnReleaseDevice',      None,      _c_void_p)
+_declare('oidnSetDevice1b',        None,      _c_void_p, _c_char_p, ctypes.c_bool)
+_declare('oidnSetDevice1i',        None,      _c_void_p, _c_char_p, ctypes.c_int)
+_declare('oidnGetDevice1b',        ctypes.c_bool, _c_void_p, _c_char_p)
+_declare('oidnGetDevice1i',        ctypes.c_int,  _c_void_p, _c_char_p)
+_declare('oidnGetDeviceError',     ctypes.c_int,  _c_void_p, ctypes.POINTER(_c_char_p))
+_declare('oidnAutotuneDevice',     None,      _c_void_p)
+_declare('oidnCommitDevice',       None,      _c_void_p)
+_declare('oidnTrimDevice',         None,      _c_void_p)
+_declare('oidnNewFilter',          _c_void_p, _c_void_p, _c_char_p)
+_declare('oidnReleaseFilter',      None,      _c_void_p)
+_declare('oidnSetSharedFilterImage', None,    _c_void_p, _c_char_p, _c_void_p, ctypes.c_int,
+                                              _c_size_t, _c_size_t, _c_size_t, _c_size_t, _c_size_t)
+_declare('oidnSetFilter1b',        None,      _c_void_p, _c_char_p, ctypes.c_bool)
+_declare('oidnSetFilter1i',        None,      _c_void_p, _c_char_p, ctypes.c_int)
+_declare('oidnSetFilter1f',        None,      _c_void_p, _c_char_p, ctypes.c_float)
+_declare('oidnGetFilter1b',        ctypes.c_bool,  _c_void_p, _c_char_p)
+_declare('oidnGetFilter1i',        ctypes.c_int,   _c_void_p, _c_char_p)
+_declare('oidnGetFilter1f',        ctypes.c_float, _c_void_p, _c_char_p)
+_declare('oidnSetFilterProgressMonitorFunction', None, _c_void_p, _ProgressMonitorFunction, _c_void_p)
+_declare('oidnCommitFilter',       None,      _c_void_p)
+_declare('oidnExecuteFilter',      None,      _c_void_p)
+_declare('oidnExecuteFilterSequence', None,   _c_void_p, ctypes.POINTER(_Frame), _c_size_t)
+
+# ----------------------------------------------------------------------------
+# Buffer protocol
+# ----------------------------------------------------------------------------
+
+class _Py_buffer(ctypes.Structure):
+  _fields_ = [('buf',        _c_void_p),
+              ('obj',        _c_void_p),
+              ('len',        ctypes.c_ssize_t),
+              ('itemsize',   ctypes.c_ssize_t),
+              ('readonly',   ctypes.c_int),
+              ('ndim',       ctypes.c_int),
+              ('format',     _c_char_p),
+              ('shape',      ctypes.POINTER(ctypes.c_ssize_t)),
+              ('strides',    ctypes.POINTER(ctypes.c_ssize_t)),
+              ('suboffsets', ctypes.POINTER(ctypes.c_ssize_t)),
+              ('internal',   _c_void_p)]
+
+_PyBUF_WRITABLE = 0x0001
+_PyBUF_FORMAT   = 0x0004
+_PyBUF_STRIDES  = 0x0018
+
+_PyObject_GetBuffer = ctypes.pythonapi.PyObject_GetBuffer
+_PyObject_GetBuffer.restype = ctypes.c_int
+_PyObject_GetBuffer.argtypes = [ctypes.py_object, ctypes.POINTER(_Py_buffer), ctypes.c_int]
+
+_PyBuffer_Release = ctypes.pythonapi.PyBuffer_Release
+_PyBuffer_Release.restype = None
+_PyBuffer_Release.argtypes = [ctypes.POINTER(_Py_buffer)]
+
+# Image shared with the library, which keeps the exporting object locked
+# (e.g. a NumPy array cannot be resized) until it is released
+class _SharedImage(object):
+  def __init__(self, obj, writable, num_channels=3):
+    self._view = _Py_buffer()
+    self._acquired = False
+    flags = _PyBUF_STRIDES | _PyBUF_FORMAT
+    if writable:
+      flags |= _PyBUF_WRITABLE
+    _PyObject_GetBuffer(obj, ctypes.byref(self._view), flags) # raises on failure
+    self._acquired = True
+
+    try:
+      view = self._view
+      fmt = view.format.lstrip(b'@=<') if view.format else b'B'
+      if fmt != b'f' or view.itemsize != 4:
+        raise TypeError('image must have float32 elements')
+      if view.ndim != 3 or view.shape[2] < num_channels:
+        raise ValueError('image must have shape (height, width, channels) with at least %d channels' % num_channels)
+
+      self.height = view.shape[0]
+      self.width  = view.shape[1]
+      self.byte_row_stride   = view.strides[0]
+      self.byte_pixel_stride = view.strides[1]
+
+      # The channels must be contiguous, and the rows must not overlap
+      if view.strides[2] != 4:
+        raise ValueError('image channels must be contiguous')
+      if self.byte_pixel_stride < num_channels * 4 or (self.height > 1 and self.byte_row_stride < self.width * self.byte_pixel_stride):
+        raise ValueError('unsupported image strides (e.g. transposed, reversed or overlapping view)')
+      if self.height == 1:
+        self.byte_row_stride = self.width * self.byte_pixel_stride
+
+      self.ptr = view.buf
+    except:
+      self.release()
+      raise
+
+  def release(self):
+    if self._acquired:
+      _PyBuffer_Release(ctypes.byref(self._view))
+      self._acquired = False
+
+  def __del__(self):
+    self.release()
+
+  def has_layout(self, other):
+    return (self.width, self.height, self.byte_pixel_stride, self.byte_row_stride) == \
+           (other.width, other.height, other.byte_pixel_stride, other.byte_row_stride)
+
+# ----------------------------------------------------------------------------
+# Device
+# ----------------------------------------------------------------------------
+
+class Error(Exception):
+  def __init__(self, code, message):
+    Exception.__init__(self, message if message else _ERROR_NAMES.get(code, 'unknown error'))
+    self.code = code
+
+def _check_error(device_handle):
+  # The errors are stored per thread, so this is safe with multiple threads
+  message = _c_char_p()
+  code = _lib.oidnGetDeviceError(device_handle, ctypes.byref(message))
+  if code != 0:
+    raise Error(code, message.value.decode() if message.value else None)
+
+class Device(object):
+  def __init__(self, type=DEVICE_TYPE_DEFAULT, **params):
+    self._handle = _lib.oidnNewDevice(type)
+    _check_error(self._handle)
+    if not self._handle:
+      raise Error(1, 'could not create device')
+    for name, value in params.items():
+      self.set(name, value)
+
+  def set(self, name, value):
+    if isinstance(value, bool):
+      _lib.oidnSetDevice1b(self._handle, name.encode(), value)
+    else:
+      _lib.oidnSetDevice1i(self._handle, name.encode(), int(value))
+    _check_error(self._handle)
+
+  def get(self, name, type=int):
+    if type is bool:
+      value = _lib.oidnGetDevice1b(self._handle, name.encode())
+    else:
+      value = _lib.oidnGetDevice1i(self._handle, name.encode())
+    _check_error(self._handle)
+    return value
+
+  # Selects the fastest thread configuration by timing a synthetic workload,
+  # and stores it in the autotuning cache of the machine (before committing)
+  def autotune(self):
+    _lib.oidnAutotuneDevice(self._handle)
+    _check_error(self._handle)
+    return self
+
+  def commit(self):
+    _lib.oidnCommitDevice(self._handle)
+    _check_error(self._handle)
+    return self
+
+  # Releases the intermediate buffers of the filters which are not executing
+  # (e.g. under memory pressure), which are re-allocated on their next execution
+  def trim(self):
+    _lib.oidnTrimDevice(self._handle)
+    _check_error(self._handle)
+
+  def release(self):
+    if self._handle:
+      _lib.oidnReleaseDevice(self._handle)
+      self._handle = None
+
+  def __del__(self):
+    self.release()
+
+  def __enter__(self):
+    return self
+
+  def __exit__(self, *args):
+    self.release()
+
+  def new_filter(self, type):
+    return Filter(self, type)
+
+# ----------------------------------------------------------------------------
+# Filter
+# ----------------------------------------------------------------------------
+
+class Filter(object):
+  def __init__(self, device, type):
+    self._device = device # keep the device alive
+    self._images = {}
+    self._progress_func = None
+    self._handle = _lib.oidnNewFilter(device._handle, type.encode())
+    _check_error(device._handle)
+
+  def _check_error(self):
+    _check_error(self._device._handle)
+
+  # Shares an image with the filter (e.g. "color", "albedo", "normal", "output",
+  # or "motion", which has 2 channels)
+  # The image is used without copying, so it must not be modified (or in case
+  # of the output, accessed) while the filter is executing.
+  def set_image(self, name, image):
+    format = FORMAT_FLOAT2 if name == 'motion' else FORMAT_FLOAT3
+    shared = _SharedImage(image, writable=(name == 'output'),
+                          num_channels=(2 if name == 'motion' else 3))
+    _lib.oidnSetSharedFilterImage(self._handle, name.encode(), shared.ptr, format,
+                                  shared.width, shared.height, 0,
+                                  shared.byte_pixel_stride, shared.byte_row_stride)
+    try:
+      self._check_error()
+    except:
+      shared.release()
+      raise
+    previous = self._images.get(name)
+    self._images[name] = shared
+    if previous:
+      previous.release()
+
+  def set(self, name, value):
+    if isinstance(value, bool):
+      _lib.oidnSetFilter1b(self._handle, name.encode(), value)
+    elif isinstance(value, float):
+      _lib.oidnSetFilter1f(self._handle, name.encode(), value)
+    else:
+      _lib.oidnSetFilter1i(self._handle, name.encode(), int(value))
+    self._check_error()
+
+  def get(self, name, type=int):
+    if type is bool:
+      value = _lib.oidnGetFilter1b(self._handle, name.encode())
+    elif type is float:
+      value = _lib.oidnGetFilter1f(self._handle, name.encode())
+    else:
+      value = _lib.oidnGetFilter1i(self._handle, name.encode())
+    self._check_error()
+    return value
+
+  # Sets the progress monitor function, which is called with the progress in
+  # [0, 1] and should return False to cancel the execution (or None to remove)
+  def set_progress_monitor(self, func):
+    if func:
+      callback = _ProgressMonitorFunction(lambda user_ptr, n: bool(func(n)))
+    else:
+      callback = _ProgressMonitorFunction()
+    _lib.oidnSetFilterProgressMonitorFunction(self._handle, callback, None)
+    self._check_error()
+    self._progress_func = callback # keep the callback alive
+
+  # Commits the changes to the filter (releases the GIL)
+  def commit(self):
+    _lib.oidnCommitFilter(self._handle)
+    self._check_error()
+    return self
+
+  # Executes the filter (releases the GIL)
+  def execute(self):
+    _lib.oidnExecuteFilter(self._handle)
+    self._check_error()
+
+  # Executes the filter on a sequence of frames (releases the GIL)
+  # Each frame is a dict of images with the same names, shapes and strides as
+  # the images set for the filter, which are shared without copying as well.
+  def execute_sequence(self, frames):
+    frames = list(frames)
+    c_frames = (_Frame * max(len(frames), 1))()
+    shared = []
+    try:
+      for i, frame in enumerate(frames):
+        for name, image in frame.items():
+          if name not in ('color', 'albedo', 'normal', 'output', 'motion'):
+            raise ValueError('invalid frame image name: ' + name)
+          if name not in self._images:
+            raise ValueError('frame image not set for the filter: ' + name)
+          image = _SharedImage(image, writable=(name == 'output'),
+                               num_channels=(2 if name == 'motion' else 3))
+          shared.append(image)
+          if not image.has_layout(self._images[name]):
+            raise ValueError('frame image has different shape or strides than the filter image: ' + name)
+          setattr(c_frames[i], name, image.ptr)
+
+      _lib.oidnExecuteFilterSequence(self._handle, c_frames, len(frames))
+      self._check_error()
+    finally:
+      for image in shared:
+        image.release()
+
+  def release(self):
+    if self._handle:
+      _lib.oidnReleaseFilter(self._handle)
+      self._handle = None
+    for image in self._images.values():
+      image.release()
+    self._images = {}
+
+  def __del__(self):
+    self.release()
+
+  def __enter__(self):
+    return self
+
+  def __exit__(self, *args):
+    self.release()
+
+# ----------------------------------------------------------------------------
+# Convenience
+# ----------------------------------------------------------------------------
+
+_default_device = None
+
+def _get_default_device():
+  global _default_device
+  if _default_device is None:
+    _default_device = Device().commit()
+  return _default_device
+
+# Denoises an image with the generic ray tracing filter, writing the result to
+# the output image
+# Uses a shared default device if none is specified. Creating a filter is
+# expensive, so use a Filter directly to denoise many images of the same size.
+def denoise(color, output, albedo=None, normal=None, hdr=False, srgb=False, device=None):
+  if device is None:
+    device = _get_default_device()
+  with Filter(device, 'RT') as filter:
+    filter.set_image('color', color)
+    if albedo is not None:
+      filter.set_image('albedo', albedo)
+    if normal is not None:
+      filter.set_image('normal', normal)
+    filter.set_image('output', output)
+    filter.set('hdr', bool(hdr))
+    filter.set('srgb', bool(srgb))
+    filter.commit()
+    filter.execute()
+  return output